@@ -0,0 +1,80 @@
+#pragma once
+
+#include "FalloffKernels.generated.h"
+
+UENUM(BlueprintType)
+enum class ETerrainFalloff : uint8
+{
+	Linear,
+	Smoothstep,
+	Gaussian,
+	Wendland,
+	InversePower
+};
+
+// In UV space, sqrt(2) is the maximum dist between 2 points
+constexpr float MAX_UV_DIST{ 1.414213f };
+
+/**
+ * Falloff kernels evaluated on the normalized distance T = dist / support radius, T in [0, 1].
+ * Every kernel is exactly 1 at T = 0 and exactly 0 at T = 1, so a node never contributes outside of its support radius.
+ */
+template<ETerrainFalloff Falloff>
+struct TFalloffKernel;
+
+template<>
+struct TFalloffKernel<ETerrainFalloff::Linear>
+{
+	static FORCEINLINE float Evaluate(float T)
+	{
+		return 1.f - T;
+	}
+};
+
+template<>
+struct TFalloffKernel<ETerrainFalloff::Smoothstep>
+{
+	static FORCEINLINE float Evaluate(float T)
+	{
+		return 1.f - T * T * (3.f - 2.f * T);
+	}
+};
+
+// Gaussian with sigma = 1/3 of the support radius, shifted & rescaled so it reaches exactly 0 at the cutoff
+template<>
+struct TFalloffKernel<ETerrainFalloff::Gaussian>
+{
+	static FORCEINLINE float Evaluate(float T)
+	{
+		constexpr float exponent{ 4.5f };
+		// exp(-4.5)
+		constexpr float cutoff{ 0.011108997f };
+		return (FMath::Exp(-exponent * T * T) - cutoff) * (1.f / (1.f - cutoff));
+	}
+};
+
+// Wendland C2, compactly supported by definition
+template<>
+struct TFalloffKernel<ETerrainFalloff::Wendland>
+{
+	static FORCEINLINE float Evaluate(float T)
+	{
+		const float oneMinusT{ 1.f - T };
+		const float sq{ oneMinusT * oneMinusT };
+		return sq * sq * (4.f * T + 1.f);
+	}
+};
+
+// 1 / (1 + 8T)^2, shifted & rescaled so it reaches exactly 0 at the cutoff
+template<>
+struct TFalloffKernel<ETerrainFalloff::InversePower>
+{
+	static FORCEINLINE float Evaluate(float T)
+	{
+		constexpr float scale{ 8.f };
+		// 1 / (1 + 8)^2
+		constexpr float cutoff{ 1.f / 81.f };
+		const float base{ 1.f / (1.f + scale * T) };
+		return (base * base - cutoff) * (1.f / (1.f - cutoff));
+	}
+};
@@ -19,6 +19,8 @@ void GraphHelper::ColorGraph(EGraphColoringAlgo algo)
 		WelshPowell(); break;
 	case EGraphColoringAlgo::DSatur:
 		DSatur(); break;
+	case EGraphColoringAlgo::TabuSearch:
+		TabuSearch(); break;
 	}
 }
 
@@ -115,9 +117,203 @@ void GraphHelper::ColorNode(const FTerrainGraphNode& Node, int index, TArray<int
 		
 	ColorsList[index] = newColor;
 
-	if (newColor >= Colors.Num())
+	// Out of palette colors
+	Nodes[index].Color = Colors.IsValidIndex(newColor) ? Colors[newColor] : FLinearColor::Black;
+}
+
+void GraphHelper::TabuSearch()
+{
+	RemainingConflicts = 0;
+	const int32 numNodes{ Nodes.Num() };
+	const int32 numColors{ Colors.Num() };
+	if (numNodes == 0 || numColors == 0) return;
+
+	// Adjacency, flattened: neighbors of node i are Adjacency[AdjacencyStart[i], AdjacencyStart[i + 1])
+	TArray<int32> adjacencyStart;
+	TArray<int32> adjacency;
+	adjacencyStart.SetNumZeroed(numNodes + 1);
+	const auto isValid{ [numNodes](const FTerrainGraphConnection& conn)
+	{
+		return conn.Element1 >= 0 && conn.Element1 < numNodes && conn.Element2 >= 0 && conn.Element2 < numNodes && conn.Element1 != conn.Element2;
+	} };
+	for (const FTerrainGraphConnection& conn : Connections)
+	{
+		if (!isValid(conn)) continue;
+		++adjacencyStart[conn.Element1 + 1];
+		++adjacencyStart[conn.Element2 + 1];
+	}
+	for (int32 i{}; i < numNodes; ++i)
+	{
+		adjacencyStart[i + 1] += adjacencyStart[i];
+	}
+	adjacency.SetNumUninitialized(adjacencyStart[numNodes]);
+	{
+		TArray<int32> cursor{ adjacencyStart };
+		for (const FTerrainGraphConnection& conn : Connections)
+		{
+			if (!isValid(conn)) continue;
+			adjacency[cursor[conn.Element1]++] = conn.Element2;
+			adjacency[cursor[conn.Element2]++] = conn.Element1;
+		}
+	}
+
+	// Seeded, so the same graph colors the same way every time
+	FRandomStream random{ numNodes };
+
+	// Start greedy: highest degree first, each node taking its least conflicting color
+	TArray<int32> color;
+	color.Init(INDEX_NONE, numNodes);
+	TArray<int32> order;
+	order.SetNumUninitialized(numNodes);
+	for (int32 i{}; i < numNodes; ++i) order[i] = i;
+	order.Sort([&adjacencyStart](int32 a, int32 b)
+	{
+		return adjacencyStart[a + 1] - adjacencyStart[a] > adjacencyStart[b + 1] - adjacencyStart[b];
+	});
+
+	// NeighborColors[node * numColors + c]: neighbors of node colored c
+	TArray<int32> neighborColors;
+	neighborColors.SetNumZeroed(numNodes * numColors);
+	for (const int32 node : order)
+	{
+		int32 bestColor{};
+		for (int32 c{ 1 }; c < numColors; ++c)
+		{
+			if (neighborColors[node * numColors + c] < neighborColors[node * numColors + bestColor]) bestColor = c;
+		}
+		color[node] = bestColor;
+		for (int32 i{ adjacencyStart[node] }; i < adjacencyStart[node + 1]; ++i)
+		{
+			++neighborColors[adjacency[i] * numColors + bestColor];
+		}
+	}
+
+	int32 conflicts{};
+	for (int32 node{}; node < numNodes; ++node)
 	{
-		Nodes[index].Color = FLinearColor::Black;
+		conflicts += neighborColors[node * numColors + color[node]];
 	}
-	Nodes[index].Color = Colors[newColor];
-}
\ No newline at end of file
+	// Every conflicting connection got counted from both ends
+	conflicts /= 2;
+
+	// Nodes with at least one conflict, with each one's position for O(1) removal
+	TArray<int32> conflicting;
+	TArray<int32> conflictingPos;
+	conflictingPos.Init(INDEX_NONE, numNodes);
+	const auto updateConflicting{ [&](int32 node)
+	{
+		const bool isConflicting{ neighborColors[node * numColors + color[node]] > 0 };
+		if (isConflicting && conflictingPos[node] == INDEX_NONE)
+		{
+			conflictingPos[node] = conflicting.Add(node);
+		}
+		else if (!isConflicting && conflictingPos[node] != INDEX_NONE)
+		{
+			const int32 last{ conflicting.Last() };
+			conflicting[conflictingPos[node]] = last;
+			conflictingPos[last] = conflictingPos[node];
+			conflicting.Pop(EAllowShrinking::No);
+			conflictingPos[node] = INDEX_NONE;
+		}
+	} };
+	for (int32 node{}; node < numNodes; ++node)
+	{
+		updateConflicting(node);
+	}
+
+	TArray<int32> bestColoring{ color };
+	int32 bestConflicts{ conflicts };
+	// Nodes recolored since bestColoring was last brought up to date; an improvement only copies those
+	TArray<int32> changedSinceBest;
+	TBitArray<> isChangedSinceBest{ false, numNodes };
+
+	// Moving a node off a color forbids moving it back for a while
+	TArray<int64> tabuUntil;
+	tabuUntil.SetNumZeroed(numNodes * numColors);
+
+	const double endTime{ FPlatformTime::Seconds() + TimeLimit };
+	for (int64 iteration{ 1 }; conflicts > 0 && numColors > 1; ++iteration)
+	{
+		// Every iteration scans all conflicting nodes & colors, so reading the clock is cheap next to it
+		if (FPlatformTime::Seconds() > endTime) break;
+
+		// Best non-tabu move among conflicting nodes; tabu ones only if they beat the best coloring so far
+		int32 moveNode{ INDEX_NONE };
+		int32 moveColor{ INDEX_NONE };
+		int32 moveDelta{ MAX_int32 };
+		int32 numTies{};
+		for (const int32 node : conflicting)
+		{
+			const int32* counts{ &neighborColors[node * numColors] };
+			const int32 current{ counts[color[node]] };
+			for (int32 c{}; c < numColors; ++c)
+			{
+				if (c == color[node]) continue;
+
+				const int32 delta{ counts[c] - current };
+				const bool isTabu{ tabuUntil[node * numColors + c] > iteration };
+				if (isTabu && conflicts + delta >= bestConflicts) continue;
+
+				if (delta < moveDelta)
+				{
+					moveNode = node;
+					moveColor = c;
+					moveDelta = delta;
+					numTies = 1;
+				}
+				else if (delta == moveDelta && random.RandRange(0, numTies++) == 0)
+				{
+					// Reservoir sampling, so ties are broken uniformly
+					moveNode = node;
+					moveColor = c;
+				}
+			}
+		}
+
+		// Everything tabu; random walk out of it
+		if (moveNode == INDEX_NONE)
+		{
+			moveNode = conflicting[random.RandRange(0, conflicting.Num() - 1)];
+			moveColor = (color[moveNode] + random.RandRange(1, numColors - 1)) % numColors;
+			moveDelta = neighborColors[moveNode * numColors + moveColor] - neighborColors[moveNode * numColors + color[moveNode]];
+		}
+
+		const int32 oldColor{ color[moveNode] };
+		color[moveNode] = moveColor;
+		conflicts += moveDelta;
+		if (!isChangedSinceBest[moveNode])
+		{
+			isChangedSinceBest[moveNode] = true;
+			changedSinceBest.Add(moveNode);
+		}
+		for (int32 i{ adjacencyStart[moveNode] }; i < adjacencyStart[moveNode + 1]; ++i)
+		{
+			const int32 neighbor{ adjacency[i] };
+			--neighborColors[neighbor * numColors + oldColor];
+			++neighborColors[neighbor * numColors + moveColor];
+			updateConflicting(neighbor);
+		}
+		updateConflicting(moveNode);
+
+		// Tenure grows with the number of conflicting nodes, as in TabuCol
+		const int32 tenure{ random.RandRange(0, 9) + FMath::CeilToInt32(0.6f * conflicting.Num()) };
+		tabuUntil[moveNode * numColors + oldColor] = iteration + tenure;
+
+		if (conflicts < bestConflicts)
+		{
+			bestConflicts = conflicts;
+			for (const int32 node : changedSinceBest)
+			{
+				bestColoring[node] = color[node];
+				isChangedSinceBest[node] = false;
+			}
+			changedSinceBest.Reset();
+		}
+	}
+
+	for (int32 node{}; node < numNodes; ++node)
+	{
+		Nodes[node].Color = Colors[bestColoring[node]];
+	}
+	RemainingConflicts = bestConflicts;
+}
@@ -19,9 +19,22 @@ struct FTerrainGraphNode
 	UPROPERTY(EditInstanceOnly, meta=(UIMin=0, UIMax=1.5f))
 	float DistanceModifier{ 1.f };
 
+	// Index of the terrain texture layer this node blends in when baking splat maps
+	UPROPERTY(EditInstanceOnly, meta=(ClampMin=0, ClampMax=255))
+	int32 TextureLayer{};
+
+	// Normalized heightmap range this node is restricted to; only used when a heightmap is set
+	UPROPERTY(EditInstanceOnly, meta=(UIMin=0, UIMax=1))
+	FVector2f HeightRange{ 0.f, 1.f };
+
+	// Terrain slope range in degrees this node is restricted to; only used when a heightmap is set
+	UPROPERTY(EditInstanceOnly, meta=(UIMin=0, UIMax=90))
+	FVector2f SlopeRange{ 0.f, 90.f };
+
 	bool operator==(const FTerrainGraphNode& rhs) const
 	{
-		return UVCoordinates == rhs.UVCoordinates && Color == rhs.Color && Intensity == rhs.Intensity && DistanceModifier == rhs.DistanceModifier;
+		return UVCoordinates == rhs.UVCoordinates && Color == rhs.Color && Intensity == rhs.Intensity && DistanceModifier == rhs.DistanceModifier && TextureLayer == rhs.TextureLayer
+			&& HeightRange == rhs.HeightRange && SlopeRange == rhs.SlopeRange;
 	}
 };
 
@@ -51,7 +64,9 @@ enum class EGraphColoringAlgo : uint8
 {
 	Greedy,
 	WelshPowell,
-	DSatur
+	DSatur,
+	// Uses exactly the palette's colors, minimizing connections whose nodes share one within a time limit
+	TabuSearch
 };
 
 class GraphHelper
@@ -60,15 +75,31 @@ public:
 	GraphHelper(TArray<FTerrainGraphNode>& nodes, TArray<FTerrainGraphConnection>& connections, TArray<FLinearColor>& colors);
 
 	void ColorGraph(EGraphColoringAlgo algo);
+
+	/** Time TabuSearch may spend before settling for the best coloring it found */
+	void SetTimeLimit(double seconds) { TimeLimit = seconds; }
+
+	/** Connections whose nodes still share a color after TabuSearch; 0 if the palette was enough */
+	int32 GetRemainingConflicts() const { return RemainingConflicts; }
 	
 private:
 	TArray<FTerrainGraphNode>& Nodes;
 	TArray<FTerrainGraphConnection>& Connections;
 	TArray<FLinearColor>& Colors;
 
+	double TimeLimit{ 1.0 };
+	int32 RemainingConflicts{};
+
 	void GreedyColoring();
 	void WelshPowell();
 	void DSatur();
+
+	/**
+	 * Tabu search (TabuCol) over colorings with exactly Colors.Num() colors.
+	 * Keeps per node & color the number of neighbors with that color, so a move's change in conflicts is
+	 * a lookup and applying it only touches the moved node's neighbors.
+	 */
+	void TabuSearch();
 	
 	TArray<int32> GetConnectedNodes(const FTerrainGraphNode& node);
 	void ColorNode(const FTerrainGraphNode& Node, int index, TArray<int32>& ColorsList);
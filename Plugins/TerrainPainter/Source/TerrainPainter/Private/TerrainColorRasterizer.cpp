@@ -0,0 +1,763 @@
+#include "TerrainColorRasterizer.h"
+
+#include "ColorHelpers.h"
+#include "TerrainHeightmap.h"
+#include "Async/ParallelFor.h"
+#include "Misc/ScopeExit.h"
+#include "Misc/ScopeLock.h"
+#include "Templates/IsInvocable.h"
+
+SIZE_T FTerrainBandScratch::GetAllocatedSize() const
+{
+	return Nodes.GetAllocatedSize() + Color.GetAllocatedSize() + Layers.GetAllocatedSize() + Heights.GetAllocatedSize() +
+		Slopes.GetAllocatedSize() + Counts.GetAllocatedSize() + Dominant.GetAllocatedSize() + DominantWeight.GetAllocatedSize();
+}
+
+TUniquePtr<FTerrainBandScratch> FTerrainBandScratchPool::Acquire()
+{
+	{
+		FScopeLock scopeLock{ &Lock };
+		if (!Free.IsEmpty())
+		{
+			return Free.Pop(EAllowShrinking::No);
+		}
+		++NumCreated;
+	}
+	return MakeUnique<FTerrainBandScratch>();
+}
+
+void FTerrainBandScratchPool::Release(TUniquePtr<FTerrainBandScratch> Scratch)
+{
+	FScopeLock scopeLock{ &Lock };
+	Free.Add(MoveTemp(Scratch));
+}
+
+int32 FTerrainBandScratchPool::GetNumCreated() const
+{
+	FScopeLock scopeLock{ &Lock };
+	return NumCreated;
+}
+
+int64 FTerrainBandScratchPool::GetFreeBytes() const
+{
+	FScopeLock scopeLock{ &Lock };
+	int64 bytes{};
+	for (const TUniquePtr<FTerrainBandScratch>& scratch : Free)
+	{
+		bytes += scratch->GetAllocatedSize();
+	}
+	return bytes;
+}
+
+FTerrainColorRasterizer::FTerrainColorRasterizer(const TArray<FTerrainGraphNode>& nodes, ETerrainFalloff falloff)
+{
+	Prepare(nodes, falloff);
+}
+
+void FTerrainColorRasterizer::Prepare(const TArray<FTerrainGraphNode>& nodes, ETerrainFalloff falloff)
+{
+	NumSourceNodes = nodes.Num();
+	Falloff = falloff;
+	NumLayers = 0;
+	Heightmap = nullptr;
+
+	PreparedNodes.Reset(nodes.Num());
+	for (int32 i{}; i < nodes.Num(); ++i)
+	{
+		const FTerrainGraphNode& node{ nodes[i] };
+		const float radius{ GetSupportRadius(node) };
+		// Nodes without any support or weight can never contribute, drop them up front
+		if (radius <= 0.f || node.Intensity == 0.f) continue;
+
+		FPreparedTerrainNode& prepared{ PreparedNodes.AddDefaulted_GetRef() };
+		prepared.UV = node.UVCoordinates;
+		prepared.SupportRadius = radius;
+		prepared.SupportRadiusSq = radius * radius;
+		prepared.InvSupportRadius = 1.f / radius;
+		prepared.Intensity = node.Intensity;
+		prepared.Layer = FMath::Clamp(node.TextureLayer, 0, MaxLayers - 1);
+		prepared.SourceIndex = i;
+		prepared.WeightedColor = node.Color * node.Intensity;
+		prepared.HeightRange = node.HeightRange;
+		prepared.SlopeRange = node.SlopeRange;
+		prepared.HasMask = node.HeightRange.X > 0.f || node.HeightRange.Y < 1.f || node.SlopeRange.X > 0.f || node.SlopeRange.Y < 90.f;
+
+		NumLayers = FMath::Max(NumLayers, prepared.Layer + 1);
+	}
+}
+
+float FTerrainColorRasterizer::GetSupportRadius(const FTerrainGraphNode& Node)
+{
+	// The distance modifier linearly scales how far (in UV) a node reaches; 1.0 covers the entire texture
+	return FMath::Max(0.f, Node.DistanceModifier) * MAX_UV_DIST;
+}
+
+void FTerrainColorRasterizer::SetHeightmap(TSharedPtr<const FTerrainHeightmap> heightmap, float maskBlend)
+{
+	// Don't bother sampling any tiles if no node is actually restricted
+	const bool anyMasked{ PreparedNodes.ContainsByPredicate([](const FPreparedTerrainNode& node){ return node.HasMask; }) };
+	Heightmap = anyMasked ? MoveTemp(heightmap) : nullptr;
+	MaskBlend = FMath::Max(0.f, maskBlend);
+}
+
+void FTerrainColorRasterizer::SetScratchPool(TSharedPtr<FTerrainBandScratchPool, ESPMode::ThreadSafe> scratchPool)
+{
+	ScratchPool = MoveTemp(scratchPool);
+}
+
+void FTerrainColorRasterizer::Rasterize(FIntPoint Size, TArrayView<FColor> OutPixels, const FTerrainSplatOutput* OutSplat) const
+{
+	check(OutPixels.Num() == Size.X * Size.Y);
+	check(!OutSplat || (OutSplat->LayerIndices.Num() == OutPixels.Num() && OutSplat->LayerWeights.Num() == OutPixels.Num()));
+
+	const int32 numBands{ FMath::DivideAndRoundUp(Size.Y, BandHeight) };
+	ParallelFor(numBands, [this, Size, &OutPixels, OutSplat](int32 band)
+	{
+		const int32 rowBegin{ band * BandHeight };
+		const int32 rowEnd{ FMath::Min(rowBegin + BandHeight, Size.Y) };
+
+		ProcessBand(Size, { 0, rowBegin, Size.X, rowEnd }, OutSplat, [Size, &OutPixels](int32 y, TArrayView<const FLinearColor> colorRow)
+		{
+			FColor* outRow{ &OutPixels[y * Size.X] };
+			for (int32 x{}; x < Size.X; ++x)
+			{
+				FLinearColor result{ NormalizeToMax(colorRow[x]) };
+				result.A = 1.f;
+				outRow[x] = result.ToFColor(false);
+			}
+		});
+	});
+}
+
+void FTerrainColorRasterizer::RasterizeTargets(TArrayView<const FTerrainBakeTarget> Targets, bool bDownsample) const
+{
+	if (Targets.IsEmpty()) return;
+
+	int32 mainIndex{};
+	for (int32 i{}; i < Targets.Num(); ++i)
+	{
+		check(Targets[i].Pixels.Num() == Targets[i].Size.X * Targets[i].Size.Y);
+		if (Targets[i].Size.X * Targets[i].Size.Y > Targets[mainIndex].Size.X * Targets[mainIndex].Size.Y) mainIndex = i;
+	}
+	const FTerrainBakeTarget& main{ Targets[mainIndex] };
+	const FIntPoint mainSize{ main.Size };
+
+	// Downsampling ratio per target, zero for targets rasterized with the kernel.
+	// Power of two rows ratios all divide the largest, so bands of that height never split a downsampled row
+	TArray<FIntPoint> ratios;
+	ratios.Init(FIntPoint::ZeroValue, Targets.Num());
+	int32 bandHeight{ BandHeight };
+	for (int32 i{}; i < Targets.Num(); ++i)
+	{
+		const FTerrainBakeTarget& target{ Targets[i] };
+		if (!bDownsample || i == mainIndex || target.Splat) continue;
+		if (mainSize.X % target.Size.X != 0 || mainSize.Y % target.Size.Y != 0) continue;
+
+		const FIntPoint ratio{ mainSize.X / target.Size.X, mainSize.Y / target.Size.Y };
+		if (!FMath::IsPowerOfTwo(ratio.Y) || ratio.Y > MaxDownsampleRatio) continue;
+
+		ratios[i] = ratio;
+		bandHeight = FMath::Max(bandHeight, ratio.Y);
+	}
+	const bool anyDownsampled{ ratios.ContainsByPredicate([](const FIntPoint& ratio){ return ratio.X > 0; }) };
+
+	const int32 numBands{ FMath::DivideAndRoundUp(mainSize.Y, bandHeight) };
+	ParallelFor(numBands, [this, Targets, &main, mainIndex, mainSize, &ratios, bandHeight, anyDownsampled](int32 band)
+	{
+		const int32 rowBegin{ band * bandHeight };
+		const int32 rowEnd{ FMath::Min(rowBegin + bandHeight, mainSize.Y) };
+
+		// Culled once over the band's whole UV range, which covers the rows every target has in it
+		TArray<int32> bandNodes;
+		GatherNodes({ 0.f, static_cast<float>(rowBegin) / mainSize.Y }, { 1.f, static_cast<float>(rowEnd) / mainSize.Y }, bandNodes);
+
+		TArray<FLinearColor> bandColors;
+		if (anyDownsampled)
+		{
+			bandColors.SetNumUninitialized((rowEnd - rowBegin) * mainSize.X);
+		}
+
+		ProcessBand(mainSize, { 0, rowBegin, mainSize.X, rowEnd }, main.Splat, [&main, mainSize, rowBegin, anyDownsampled, &bandColors](int32 y, TArrayView<const FLinearColor> colorRow)
+		{
+			FColor* outRow{ &main.Pixels[y * mainSize.X] };
+			for (int32 x{}; x < mainSize.X; ++x)
+			{
+				FLinearColor result{ NormalizeToMax(colorRow[x]) };
+				result.A = 1.f;
+				outRow[x] = result.ToFColor(false);
+				if (anyDownsampled) bandColors[(y - rowBegin) * mainSize.X + x] = result;
+			}
+		}, &bandNodes);
+
+		for (int32 i{}; i < Targets.Num(); ++i)
+		{
+			if (i == mainIndex) continue;
+			const FTerrainBakeTarget& target{ Targets[i] };
+
+			if (ratios[i].X > 0)
+			{
+				// Box filter of the band's unquantized colors
+				const FIntPoint ratio{ ratios[i] };
+				const float invArea{ 1.f / (ratio.X * ratio.Y) };
+				for (int32 ty{ rowBegin / ratio.Y }; ty < rowEnd / ratio.Y; ++ty)
+				{
+					for (int32 tx{}; tx < target.Size.X; ++tx)
+					{
+						FLinearColor sum{ FLinearColor::Transparent };
+						for (int32 dy{}; dy < ratio.Y; ++dy)
+						{
+							const FLinearColor* source{ &bandColors[(ty * ratio.Y + dy - rowBegin) * mainSize.X + tx * ratio.X] };
+							for (int32 dx{}; dx < ratio.X; ++dx)
+							{
+								sum += source[dx];
+							}
+						}
+						target.Pixels[ty * target.Size.X + tx] = (sum * invArea).ToFColor(false);
+					}
+				}
+				continue;
+			}
+
+			// The target's rows whose V falls into this band: ty / Target.Y in [rowBegin / Main.Y, rowEnd / Main.Y)
+			const int32 targetBegin{ static_cast<int32>(FMath::DivideAndRoundUp(static_cast<int64>(rowBegin) * target.Size.Y, static_cast<int64>(mainSize.Y))) };
+			const int32 targetEnd{ static_cast<int32>(FMath::DivideAndRoundUp(static_cast<int64>(rowEnd) * target.Size.Y, static_cast<int64>(mainSize.Y))) };
+			if (targetBegin >= targetEnd) continue;
+
+			ProcessBand(target.Size, { 0, targetBegin, target.Size.X, targetEnd }, target.Splat, [&target](int32 y, TArrayView<const FLinearColor> colorRow)
+			{
+				FColor* outRow{ &target.Pixels[y * target.Size.X] };
+				for (int32 x{}; x < target.Size.X; ++x)
+				{
+					FLinearColor result{ NormalizeToMax(colorRow[x]) };
+					result.A = 1.f;
+					outRow[x] = result.ToFColor(false);
+				}
+			}, &bandNodes);
+		}
+	});
+}
+
+void FTerrainColorRasterizer::RasterizeDebug(
+	FIntPoint Size, TArrayView<FColor> OutPixels, const FTerrainRasterDebugOutput& OutDebug, FTerrainRasterStats& OutStats) const
+{
+	const int32 numPixels{ Size.X * Size.Y };
+	check(OutPixels.Num() == numPixels);
+	check(OutDebug.NodesPerPixel.Num() == numPixels && OutDebug.DominantNode.Num() == numPixels && OutDebug.Overshoot.Num() == numPixels);
+
+	const int32 numBands{ FMath::DivideAndRoundUp(Size.Y, BandHeight) };
+	TArray<FDebugBand> bands;
+	bands.SetNum(numBands);
+
+	ParallelFor(numBands, [this, Size, &OutPixels, &OutDebug, &bands](int32 band)
+	{
+		const int32 rowBegin{ band * BandHeight };
+		const int32 rowEnd{ FMath::Min(rowBegin + BandHeight, Size.Y) };
+
+		FDebugBand& debug{ bands[band] };
+		debug.Output = &OutDebug;
+
+		ProcessBand(Size, { 0, rowBegin, Size.X, rowEnd }, nullptr, [Size, &OutPixels, &OutDebug, &debug](int32 y, TArrayView<const FLinearColor> colorRow)
+		{
+			for (int32 x{}; x < Size.X; ++x)
+			{
+				const int32 index{ y * Size.X + x };
+				// Same test as NormalizeToMax
+				const float overshoot{ FMath::Max(0.f, colorRow[x].GetMax() - 1.f) };
+				OutDebug.Overshoot[index] = overshoot;
+				debug.ClippedPixels += overshoot > 0.f ? 1 : 0;
+
+				FLinearColor result{ NormalizeToMax(colorRow[x]) };
+				result.A = 1.f;
+				OutPixels[index] = result.ToFColor(false);
+			}
+		}, nullptr, &debug);
+	});
+
+	// Merge the bands' partial results
+	OutStats = {};
+	OutStats.NodePixels.SetNumZeroed(NumSourceNodes);
+	OutStats.NodeDominantPixels.SetNumZeroed(NumSourceNodes);
+
+	int64 totalNodesPerPixel{};
+	int64 clippedPixels{};
+	for (const FDebugBand& band : bands)
+	{
+		totalNodesPerPixel += band.TotalNodesPerPixel;
+		clippedPixels += band.ClippedPixels;
+		OutStats.MaxNodesPerPixel = FMath::Max(OutStats.MaxNodesPerPixel, band.MaxNodesPerPixel);
+
+		for (int32 slot{}; slot < band.Nodes.Num(); ++slot)
+		{
+			const int32 node{ PreparedNodes[band.Nodes[slot]].SourceIndex };
+			OutStats.NodePixels[node] += band.NodePixels[slot];
+			OutStats.NodeDominantPixels[node] += band.NodeDominantPixels[slot];
+		}
+	}
+
+	if (numPixels > 0)
+	{
+		OutStats.MeanNodesPerPixel = static_cast<double>(totalNodesPerPixel) / numPixels;
+		OutStats.ClippedFraction = static_cast<double>(clippedPixels) / numPixels;
+	}
+}
+
+void FTerrainColorRasterizer::RasterizeGroupWeights(FIntPoint Size, TArrayView<const int32> NodeGroups, int32 NumGroups, FTerrainGroupWeights& Out) const
+{
+	check(NodeGroups.Num() == NumSourceNodes);
+
+	// A copy accumulating groups where it would accumulate texture layers, and only ungrouped nodes' colors.
+	// Ungrouped nodes share one extra layer, which is never read
+	FTerrainColorRasterizer grouped{ *this };
+	for (FPreparedTerrainNode& node : grouped.PreparedNodes)
+	{
+		const int32 group{ NodeGroups[node.SourceIndex] };
+		check(group == INDEX_NONE || (group >= 0 && group < NumGroups));
+		node.Layer = group != INDEX_NONE ? group : NumGroups;
+		if (group != INDEX_NONE) node.WeightedColor = FLinearColor::Transparent;
+	}
+	grouped.NumLayers = NumGroups + 1;
+	const int32 numLayers{ grouped.NumLayers };
+
+	// Each band compacts its own rows, then the bands are stitched together in order
+	struct FBandWeights
+	{
+		TArray<int32> Counts;
+		TArray<int32> Groups;
+		TArray<float> Weights;
+		TArray<FLinearColor> FixedColors;
+	};
+	const int32 numBands{ FMath::DivideAndRoundUp(Size.Y, BandHeight) };
+	TArray<FBandWeights> bands;
+	bands.SetNum(numBands);
+
+	ParallelFor(numBands, [&grouped, Size, NumGroups, numLayers, &bands](int32 band)
+	{
+		const int32 rowBegin{ band * BandHeight };
+		const int32 rowEnd{ FMath::Min(rowBegin + BandHeight, Size.Y) };
+
+		FBandWeights& out{ bands[band] };
+		out.Counts.Reserve((rowEnd - rowBegin) * Size.X);
+		out.FixedColors.Reserve((rowEnd - rowBegin) * Size.X);
+
+		grouped.ProcessBand(Size, { 0, rowBegin, Size.X, rowEnd }, nullptr,
+			[Size, NumGroups, numLayers, &out](int32, TArrayView<const FLinearColor> colorRow, TArrayView<const float> layerRow)
+		{
+			out.FixedColors.Append(colorRow.GetData(), Size.X);
+			for (int32 x{}; x < Size.X; ++x)
+			{
+				int32 count{};
+				for (int32 group{}; group < NumGroups; ++group)
+				{
+					const float weight{ layerRow[x * numLayers + group] };
+					if (weight <= 0.f) continue;
+
+					out.Groups.Add(group);
+					out.Weights.Add(weight);
+					++count;
+				}
+				out.Counts.Add(count);
+			}
+		});
+	});
+
+	int32 numEntries{};
+	for (const FBandWeights& band : bands)
+	{
+		numEntries += band.Groups.Num();
+	}
+
+	Out.Size = Size;
+	Out.Offsets.SetNumUninitialized(Size.X * Size.Y + 1);
+	Out.Groups.Reset(numEntries);
+	Out.Weights.Reset(numEntries);
+	Out.FixedColors.Reset(Size.X * Size.Y);
+
+	int32 pixel{};
+	Out.Offsets[0] = 0;
+	for (const FBandWeights& band : bands)
+	{
+		for (const int32 count : band.Counts)
+		{
+			Out.Offsets[pixel + 1] = Out.Offsets[pixel] + count;
+			++pixel;
+		}
+		Out.Groups.Append(band.Groups);
+		Out.Weights.Append(band.Weights);
+		Out.FixedColors.Append(band.FixedColors);
+	}
+}
+
+void FTerrainColorRasterizer::ResolveGroupColors(const FTerrainGroupWeights& GroupWeights, TArrayView<const FLinearColor> GroupColors, TArrayView<FColor> OutPixels)
+{
+	const FIntPoint size{ GroupWeights.Size };
+	check(OutPixels.Num() == size.X * size.Y);
+
+	ParallelFor(size.Y, [&GroupWeights, GroupColors, &OutPixels, size](int32 y)
+	{
+		for (int32 pixel{ y * size.X }; pixel < (y + 1) * size.X; ++pixel)
+		{
+			FLinearColor color{ GroupWeights.FixedColors[pixel] };
+			for (int32 i{ GroupWeights.Offsets[pixel] }; i < GroupWeights.Offsets[pixel + 1]; ++i)
+			{
+				color += GroupColors[GroupWeights.Groups[i]] * GroupWeights.Weights[i];
+			}
+
+			FLinearColor result{ NormalizeToMax(color) };
+			result.A = 1.f;
+			OutPixels[pixel] = result.ToFColor(false);
+		}
+	});
+}
+
+void FTerrainColorRasterizer::RasterizeRegion(FIntPoint Size, const FIntRect& Region, TArrayView<FColor> OutPixels) const
+{
+	const int32 width{ Region.Width() };
+	check(Region.Min.X >= 0 && Region.Min.Y >= 0 && Region.Max.X <= Size.X && Region.Max.Y <= Size.Y);
+	check(OutPixels.Num() == width * Region.Height());
+
+	const int32 numBands{ FMath::DivideAndRoundUp(Region.Height(), BandHeight) };
+	ParallelFor(numBands, [this, Size, &Region, width, &OutPixels](int32 band)
+	{
+		const int32 rowBegin{ Region.Min.Y + band * BandHeight };
+		const int32 rowEnd{ FMath::Min(rowBegin + BandHeight, Region.Max.Y) };
+
+		ProcessBand(Size, { Region.Min.X, rowBegin, Region.Max.X, rowEnd }, nullptr, [&Region, width, &OutPixels](int32 y, TArrayView<const FLinearColor> colorRow)
+		{
+			FColor* outRow{ &OutPixels[(y - Region.Min.Y) * width] };
+			for (int32 x{ Region.Min.X }; x < Region.Max.X; ++x)
+			{
+				FLinearColor result{ NormalizeToMax(colorRow[x]) };
+				result.A = 1.f;
+				outRow[x - Region.Min.X] = result.ToFColor(false);
+			}
+		});
+	});
+}
+
+void FTerrainColorRasterizer::RasterizeBand(FIntPoint Size, int32 RowBegin, int32 RowEnd, TArrayView<FLinearColor> OutRows) const
+{
+	check(OutRows.Num() >= (RowEnd - RowBegin) * Size.X);
+
+	ProcessBand(Size, { 0, RowBegin, Size.X, RowEnd }, nullptr, [Size, RowBegin, &OutRows](int32 y, TArrayView<const FLinearColor> colorRow)
+	{
+		FLinearColor* outRow{ &OutRows[(y - RowBegin) * Size.X] };
+		for (int32 x{}; x < Size.X; ++x)
+		{
+			outRow[x] = NormalizeToMax(colorRow[x]);
+			outRow[x].A = 1.f;
+		}
+	});
+}
+
+FIntRect FTerrainColorRasterizer::GetPixelBounds(const FTerrainGraphNode& Node, FIntPoint Size)
+{
+	const float radius{ GetSupportRadius(Node) };
+	// Rounded outwards; a pixel too many only costs a little extra work, one too few leaves a stale seam
+	FIntRect bounds{
+		FMath::FloorToInt32((Node.UVCoordinates.X - radius) * Size.X), FMath::FloorToInt32((Node.UVCoordinates.Y - radius) * Size.Y),
+		FMath::CeilToInt32((Node.UVCoordinates.X + radius) * Size.X) + 1, FMath::CeilToInt32((Node.UVCoordinates.Y + radius) * Size.Y) + 1
+	};
+	bounds.Clip({ 0, 0, Size.X, Size.Y });
+	return bounds;
+}
+
+template<typename TRowSink>
+void FTerrainColorRasterizer::ProcessBand(
+	FIntPoint Size, const FIntRect& Region, const FTerrainSplatOutput* OutSplat, TRowSink&& RowSink,
+	const TArray<int32>* SharedBandNodes, FDebugBand* Debug) const
+{
+	TUniquePtr<FTerrainBandScratch> scratch{ ScratchPool ? ScratchPool->Acquire() : MakeUnique<FTerrainBandScratch>() };
+	ON_SCOPE_EXIT
+	{
+		if (ScratchPool) ScratchPool->Release(MoveTemp(scratch));
+	};
+
+	if (!SharedBandNodes)
+	{
+		GatherBandNodes(Size, Region, scratch->Nodes);
+	}
+	const TArray<int32>& bandNodes{ SharedBandNodes ? *SharedBandNodes : scratch->Nodes };
+
+	// Only the heightmap rows under this band are ever resident
+	TOptional<FTerrainHeightmapTile> tile;
+	if (Heightmap) tile.Emplace(Heightmap->GetTile(Size.Y, Region.Min.Y, Region.Max.Y));
+
+	// Rows a band doesn't use are left empty, which is how AccumulateRow tells what to accumulate
+	const auto prepareRow{ [](auto& row, bool isUsed, int32 num)
+	{
+		if (isUsed) row.SetNumUninitialized(num, EAllowShrinking::No);
+		else row.Reset();
+	} };
+
+	constexpr bool sinkTakesLayers{ TIsInvocable<TRowSink, int32, TArrayView<const FLinearColor>, TArrayView<const float>>::Value };
+	const bool withLayers{ OutSplat || sinkTakesLayers };
+
+	TArray<FLinearColor>& colorRow{ scratch->Color };
+	TArray<float>& layerRow{ scratch->Layers };
+	TArray<float>& heightRow{ scratch->Heights };
+	TArray<float>& slopeRow{ scratch->Slopes };
+	TArray<int32>& countRow{ scratch->Counts };
+	TArray<int32>& dominantRow{ scratch->Dominant };
+	TArray<float>& dominantWeightRow{ scratch->DominantWeight };
+	prepareRow(colorRow, true, Size.X);
+	prepareRow(layerRow, withLayers, Size.X * NumLayers);
+	prepareRow(heightRow, tile.IsSet(), Size.X);
+	prepareRow(slopeRow, tile.IsSet(), Size.X);
+	prepareRow(countRow, Debug != nullptr, Size.X);
+	prepareRow(dominantRow, Debug != nullptr, Size.X);
+	prepareRow(dominantWeightRow, Debug != nullptr, Size.X);
+
+	if (Debug)
+	{
+		Debug->Nodes = bandNodes;
+		Debug->NodePixels.SetNumZeroed(bandNodes.Num());
+		Debug->NodeDominantPixels.SetNumZeroed(bandNodes.Num());
+	}
+
+	for (int32 y{ Region.Min.Y }; y < Region.Max.Y; ++y)
+	{
+		FMemory::Memzero(&colorRow[Region.Min.X], Region.Width() * sizeof(FLinearColor));
+		if (withLayers)
+		{
+			FMemory::Memzero(&layerRow[Region.Min.X * NumLayers], Region.Width() * NumLayers * sizeof(float));
+		}
+
+		if (tile)
+		{
+			// Height & slope get sampled once per pixel here, not once per node
+			const float v{ static_cast<float>(y) / Size.Y };
+			for (int32 x{ Region.Min.X }; x < Region.Max.X; ++x)
+			{
+				const FVector2f uv{ static_cast<float>(x) / Size.X, v };
+				heightRow[x] = tile->SampleHeight(uv);
+				slopeRow[x] = tile->SampleSlope(uv);
+			}
+		}
+
+		if (Debug)
+		{
+			FMemory::Memzero(&countRow[Region.Min.X], Region.Width() * sizeof(int32));
+			FMemory::Memzero(&dominantWeightRow[Region.Min.X], Region.Width() * sizeof(float));
+			for (int32 x{ Region.Min.X }; x < Region.Max.X; ++x)
+			{
+				dominantRow[x] = INDEX_NONE;
+			}
+		}
+
+		const FRowContext row{
+			y, Region.Min.X, Region.Max.X, colorRow, layerRow, heightRow, slopeRow,
+			countRow, dominantRow, dominantWeightRow, Debug ? TArrayView<int64>{ Debug->NodePixels } : TArrayView<int64>{}
+		};
+		AccumulateRow(Size, bandNodes, row);
+
+		if (OutSplat)
+		{
+			for (int32 x{ Region.Min.X }; x < Region.Max.X; ++x)
+			{
+				const int32 index{ y * Size.X + x };
+				PackTopLayers(&layerRow[x * NumLayers], OutSplat->LayerIndices[index], OutSplat->LayerWeights[index]);
+			}
+		}
+
+		if (Debug)
+		{
+			for (int32 x{ Region.Min.X }; x < Region.Max.X; ++x)
+			{
+				const int32 index{ y * Size.X + x };
+				const int32 slot{ dominantRow[x] };
+				Debug->Output->NodesPerPixel[index] = countRow[x];
+				Debug->Output->DominantNode[index] = slot != INDEX_NONE ? PreparedNodes[bandNodes[slot]].SourceIndex : INDEX_NONE;
+				Debug->TotalNodesPerPixel += countRow[x];
+				Debug->MaxNodesPerPixel = FMath::Max(Debug->MaxNodesPerPixel, countRow[x]);
+				if (slot != INDEX_NONE) ++Debug->NodeDominantPixels[slot];
+			}
+		}
+
+		if constexpr (sinkTakesLayers)
+		{
+			RowSink(y, colorRow, layerRow);
+		}
+		else
+		{
+			RowSink(y, colorRow);
+		}
+	}
+}
+
+void FTerrainColorRasterizer::GatherBandNodes(FIntPoint Size, const FIntRect& Region, TArray<int32>& OutNodes) const
+{
+	const FVector2f uvMin{ static_cast<float>(Region.Min.X) / Size.X, static_cast<float>(Region.Min.Y) / Size.Y };
+	const FVector2f uvMax{ static_cast<float>(Region.Max.X - 1) / Size.X, static_cast<float>(Region.Max.Y - 1) / Size.Y };
+	GatherNodes(uvMin, uvMax, OutNodes);
+}
+
+void FTerrainColorRasterizer::GatherNodes(FVector2f UVMin, FVector2f UVMax, TArray<int32>& OutNodes) const
+{
+	OutNodes.Reset();
+	for (int32 i{}; i < PreparedNodes.Num(); ++i)
+	{
+		const FPreparedTerrainNode& node{ PreparedNodes[i] };
+		if (node.UV.Y + node.SupportRadius < UVMin.Y || node.UV.Y - node.SupportRadius > UVMax.Y) continue;
+		if (node.UV.X + node.SupportRadius < UVMin.X || node.UV.X - node.SupportRadius > UVMax.X) continue;
+		OutNodes.Add(i);
+	}
+}
+
+void FTerrainColorRasterizer::AccumulateRow(FIntPoint Size, const TArray<int32>& BandNodes, const FRowContext& Row) const
+{
+	// Dispatch once per row, so features a row doesn't use cost nothing in the per-pixel loop
+	const int32 variant{ (Row.Layers.IsEmpty() ? 0 : 1) | (Row.Heights.IsEmpty() ? 0 : 2) | (Row.NodeCounts.IsEmpty() ? 0 : 4) };
+	switch (variant)
+	{
+	case 0: AccumulateRowKernel<false, false, false>(Size, BandNodes, Row); break;
+	case 1: AccumulateRowKernel<true, false, false>(Size, BandNodes, Row); break;
+	case 2: AccumulateRowKernel<false, true, false>(Size, BandNodes, Row); break;
+	case 3: AccumulateRowKernel<true, true, false>(Size, BandNodes, Row); break;
+	case 4: AccumulateRowKernel<false, false, true>(Size, BandNodes, Row); break;
+	case 5: AccumulateRowKernel<true, false, true>(Size, BandNodes, Row); break;
+	case 6: AccumulateRowKernel<false, true, true>(Size, BandNodes, Row); break;
+	case 7: AccumulateRowKernel<true, true, true>(Size, BandNodes, Row); break;
+	default: checkNoEntry();
+	}
+}
+
+template<bool bWithLayers, bool bWithMasks, bool bWithDebug>
+void FTerrainColorRasterizer::AccumulateRowKernel(FIntPoint Size, const TArray<int32>& BandNodes, const FRowContext& Row) const
+{
+	// The kernel is inlined into each instantiation
+	switch (Falloff)
+	{
+	case ETerrainFalloff::Linear:
+		AccumulateRowImpl<ETerrainFalloff::Linear, bWithLayers, bWithMasks, bWithDebug>(Size, BandNodes, Row); break;
+	case ETerrainFalloff::Smoothstep:
+		AccumulateRowImpl<ETerrainFalloff::Smoothstep, bWithLayers, bWithMasks, bWithDebug>(Size, BandNodes, Row); break;
+	case ETerrainFalloff::Gaussian:
+		AccumulateRowImpl<ETerrainFalloff::Gaussian, bWithLayers, bWithMasks, bWithDebug>(Size, BandNodes, Row); break;
+	case ETerrainFalloff::Wendland:
+		AccumulateRowImpl<ETerrainFalloff::Wendland, bWithLayers, bWithMasks, bWithDebug>(Size, BandNodes, Row); break;
+	case ETerrainFalloff::InversePower:
+		AccumulateRowImpl<ETerrainFalloff::InversePower, bWithLayers, bWithMasks, bWithDebug>(Size, BandNodes, Row); break;
+	}
+}
+
+template<ETerrainFalloff Kernel, bool bWithLayers, bool bWithMasks, bool bWithDebug>
+void FTerrainColorRasterizer::AccumulateRowImpl(FIntPoint Size, const TArray<int32>& BandNodes, const FRowContext& Row) const
+{
+	const float invWidth{ 1.f / Size.X };
+	const float v{ static_cast<float>(Row.Y) / Size.Y };
+	const float slopeBlend{ MaskBlend * 90.f };
+
+	for (int32 slot{}; slot < BandNodes.Num(); ++slot)
+	{
+		const FPreparedTerrainNode& node{ PreparedNodes[BandNodes[slot]] };
+
+		// Intersect this row with the node's support circle to get the span of pixels it touches
+		const float dv{ v - node.UV.Y };
+		const float dvSq{ dv * dv };
+		const float halfWidthSq{ node.SupportRadiusSq - dvSq };
+		if (halfWidthSq <= 0.f) continue;
+
+		const float halfWidth{ FMath::Sqrt(halfWidthSq) };
+		const int32 xBegin{ FMath::Max(Row.XBegin, FMath::CeilToInt32((node.UV.X - halfWidth) * Size.X)) };
+		const int32 xEnd{ FMath::Min(Row.XEnd - 1, FMath::FloorToInt32((node.UV.X + halfWidth) * Size.X)) };
+
+		if constexpr (bWithDebug)
+		{
+			Row.SlotPixels[slot] += FMath::Max(0, xEnd - xBegin + 1);
+		}
+
+		for (int32 x{ xBegin }; x <= xEnd; ++x)
+		{
+			const float du{ x * invWidth - node.UV.X };
+			const float t{ FMath::Min(FMath::Sqrt(du * du + dvSq) * node.InvSupportRadius, 1.f) };
+			float weight{ TFalloffKernel<Kernel>::Evaluate(t) };
+
+			if constexpr (bWithMasks)
+			{
+				if (node.HasMask)
+				{
+					weight *= RangeMask(Row.Heights[x], node.HeightRange, 1.f, MaskBlend) * RangeMask(Row.Slopes[x], node.SlopeRange, 90.f, slopeBlend);
+				}
+			}
+
+			Row.Color[x] += node.WeightedColor * weight;
+
+			if constexpr (bWithLayers)
+			{
+				Row.Layers[x * NumLayers + node.Layer] += weight * node.Intensity;
+			}
+
+			if constexpr (bWithDebug)
+			{
+				++Row.NodeCounts[x];
+				if (weight * node.Intensity > Row.DominantWeight[x])
+				{
+					Row.DominantWeight[x] = weight * node.Intensity;
+					Row.DominantSlot[x] = slot;
+				}
+			}
+		}
+	}
+}
+
+float FTerrainColorRasterizer::RangeMask(float Value, FVector2f Range, float DomainMax, float Blend)
+{
+	// A bound at the domain's limit has nothing beyond it to fade into, so it holds fully right up to it
+	const float lower{ Range.X <= 0.f ? -UE_BIG_NUMBER : Range.X };
+	const float upper{ Range.Y >= DomainMax ? UE_BIG_NUMBER : Range.Y };
+
+	if (Blend <= 0.f)
+	{
+		return Value >= lower && Value <= upper ? 1.f : 0.f;
+	}
+
+	// Linear ramps centered on both (inner) range edges
+	const float distInside{ FMath::Min(Value - lower, upper - Value) };
+	return FMath::Clamp(distInside / Blend + 0.5f, 0.f, 1.f);
+}
+
+void FTerrainColorRasterizer::PackTopLayers(const float* LayerWeights, FColor& OutIndices, FColor& OutWeights) const
+{
+	constexpr int32 numSlots{ 4 };
+	int32 topLayers[numSlots]{};
+	float topWeights[numSlots]{};
+
+	// Insertion into a sorted top-4; NumLayers is small, so this beats any heap
+	for (int32 layer{}; layer < NumLayers; ++layer)
+	{
+		const float weight{ LayerWeights[layer] };
+		if (weight <= topWeights[numSlots - 1]) continue;
+
+		int32 slot{ numSlots - 1 };
+		while (slot > 0 && topWeights[slot - 1] < weight)
+		{
+			topWeights[slot] = topWeights[slot - 1];
+			topLayers[slot] = topLayers[slot - 1];
+			--slot;
+		}
+		topWeights[slot] = weight;
+		topLayers[slot] = layer;
+	}
+
+	OutIndices = FColor(topLayers[0], topLayers[1], topLayers[2], topLayers[3]);
+
+	const float total{ topWeights[0] + topWeights[1] + topWeights[2] + topWeights[3] };
+	if (total <= 0.f)
+	{
+		// Nothing reaches this pixel; fall back to fully using the first layer
+		OutWeights = FColor(255, 0, 0, 0);
+		return;
+	}
+
+	uint8 quantized[numSlots];
+	int32 quantizedSum{};
+	for (int32 slot{ 1 }; slot < numSlots; ++slot)
+	{
+		quantized[slot] = static_cast<uint8>(FMath::RoundToInt32(topWeights[slot] / total * 255.f));
+		quantizedSum += quantized[slot];
+	}
+	// The strongest layer takes the rounding remainder so the weights always add up to exactly 255
+	quantized[0] = static_cast<uint8>(FMath::Max(0, 255 - quantizedSum));
+
+	OutWeights = FColor(quantized[0], quantized[1], quantized[2], quantized[3]);
+}
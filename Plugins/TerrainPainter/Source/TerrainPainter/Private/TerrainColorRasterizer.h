@@ -0,0 +1,277 @@
+#pragma once
+
+#include "FalloffKernels.h"
+#include "GraphHelpers.h"
+
+class FTerrainHeightmap;
+
+/** Node data pre-transformed for the inner rasterization loop */
+struct FPreparedTerrainNode
+{
+	FVector2f UV{};
+	float SupportRadius{};
+	float SupportRadiusSq{};
+	float InvSupportRadius{};
+	float Intensity{};
+	int32 Layer{};
+	// Index into the nodes the rasterizer was made from
+	int32 SourceIndex{};
+	FLinearColor WeightedColor{};
+
+	// Height & slope masks; HasMask is false when both cover their full range
+	bool HasMask{};
+	FVector2f HeightRange{};
+	FVector2f SlopeRange{};
+};
+
+/**
+ * Packed splat maps holding the 4 strongest texture layers per pixel.
+ * Both views are row-major and Size.X * Size.Y in size; RGBA of LayerIndices holds the layer indices,
+ * RGBA of LayerWeights the matching weights, normalized so they add up to 255.
+ */
+struct FTerrainSplatOutput
+{
+	TArrayView<FColor> LayerIndices;
+	TArrayView<FColor> LayerWeights;
+};
+
+/** Working memory of one band: its culled nodes and row buffers */
+struct FTerrainBandScratch
+{
+	TArray<int32> Nodes;
+	TArray<FLinearColor> Color;
+	TArray<float> Layers;
+	TArray<float> Heights;
+	TArray<float> Slopes;
+	TArray<int32> Counts;
+	TArray<int32> Dominant;
+	TArray<float> DominantWeight;
+
+	SIZE_T GetAllocatedSize() const;
+};
+
+/**
+ * Band scratch shared between rasterizations, so renders reuse the rows of earlier ones rather than allocate their own.
+ * Holds about as many as bands ever run at once; usable from any thread.
+ */
+class FTerrainBandScratchPool
+{
+public:
+	TUniquePtr<FTerrainBandScratch> Acquire();
+	void Release(TUniquePtr<FTerrainBandScratch> Scratch);
+
+	int32 GetNumCreated() const;
+	/** Memory held by the idle scratch */
+	int64 GetFreeBytes() const;
+
+private:
+	mutable FCriticalSection Lock;
+	TArray<TUniquePtr<FTerrainBandScratch>> Free;
+	int32 NumCreated{};
+};
+
+/** One output of a multi-resolution bake */
+struct FTerrainBakeTarget
+{
+	FIntPoint Size{};
+	// Row-major, Size.X * Size.Y
+	TArrayView<FColor> Pixels;
+	// Optional top-4 layer splat maps, as for Rasterize
+	const FTerrainSplatOutput* Splat{};
+};
+
+/** Per-pixel diagnostics of a debug rasterization; all row-major and Size.X * Size.Y in size */
+struct FTerrainRasterDebugOutput
+{
+	// Nodes evaluated for the pixel, i.e. whose support covers it
+	TArrayView<int32> NodesPerPixel;
+	// Node contributing the most weight to the pixel, INDEX_NONE where none does
+	TArrayView<int32> DominantNode;
+	// How far the largest accumulated channel went beyond 1 before NormalizeToMax scaled it back, 0 if it didn't
+	TArrayView<float> Overshoot;
+};
+
+/** Totals of a debug rasterization */
+struct FTerrainRasterStats
+{
+	double MeanNodesPerPixel{};
+	int32 MaxNodesPerPixel{};
+	// Share of pixels NormalizeToMax had to scale down
+	double ClippedFraction{};
+	// Per input node: pixels it got evaluated on (its cost) and pixels it dominates
+	TArray<int64> NodePixels;
+	TArray<int64> NodeDominantPixels;
+};
+
+/** Per-pixel weights of node groups, stored sparse: only groups reaching a pixel get an entry */
+struct FTerrainGroupWeights
+{
+	FIntPoint Size{};
+	// Entries of pixel i are [Offsets[i], Offsets[i + 1]), pixels row-major
+	TArray<int32> Offsets;
+	TArray<int32> Groups;
+	TArray<float> Weights;
+	// Per pixel, the summed weighted colors of the nodes in no group, which every recoloring keeps
+	TArray<FLinearColor> FixedColors;
+};
+
+/**
+ * Scanline rasterizer for the weighted terrain color field.
+ * Nodes only get evaluated over the pixels inside their support radius, and the falloff is
+ * resolved at compile time per kernel so the per-pixel loop has no dispatch.
+ */
+class FTerrainColorRasterizer
+{
+public:
+	FTerrainColorRasterizer(const TArray<FTerrainGraphNode>& nodes, ETerrainFalloff falloff);
+
+	/** Sets the rasterizer up for nodes anew, reusing the memory of the previous nodes; clears the heightmap */
+	void Prepare(const TArray<FTerrainGraphNode>& nodes, ETerrainFalloff falloff);
+
+	/** Bands take their working memory from scratchPool rather than allocating it; copies share the pool */
+	void SetScratchPool(TSharedPtr<FTerrainBandScratchPool, ESPMode::ThreadSafe> scratchPool);
+
+	/**
+	 * Restricts nodes to their height & slope ranges, sampled from Heightmap one band at a time.
+	 * The rasterizer shares ownership, so copies of it rendering on workers keep the heightmap alive.
+	 * @param maskBlend Width of the soft edge around each range, in normalized height; slopes use it scaled to 90 degrees
+	 */
+	void SetHeightmap(TSharedPtr<const FTerrainHeightmap> heightmap, float maskBlend);
+
+	/**
+	 * Rasterizes the full color map into OutPixels, which is row-major and Size.X * Size.Y in size.
+	 * If OutSplat is given, the top-4 layer splat maps are filled in the same pass.
+	 */
+	void Rasterize(FIntPoint Size, TArrayView<FColor> OutPixels, const FTerrainSplatOutput* OutSplat = nullptr) const;
+
+	/**
+	 * Rasterizes several resolutions of the color map in one parallel pass.
+	 * Bands run over the largest target; the nodes culled for a band serve the matching rows of every other target too.
+	 * With bDownsample, targets the largest one's size divides into (by powers of two vertically) are box-filtered from
+	 * its band while still in cache instead of being rasterized; others, and any target with splat maps, use the kernel.
+	 */
+	void RasterizeTargets(TArrayView<const FTerrainBakeTarget> Targets, bool bDownsample) const;
+
+	/**
+	 * Rasterizes the full color map like Rasterize, additionally filling OutDebug and OutStats.
+	 * The diagnostics come out of the same pass; each band reduces its own share, merged into OutStats at the end.
+	 */
+	void RasterizeDebug(FIntPoint Size, TArrayView<FColor> OutPixels, const FTerrainRasterDebugOutput& OutDebug, FTerrainRasterStats& OutStats) const;
+
+	/**
+	 * Rasterizes the summed weight of every group of nodes per pixel, e.g. of all nodes sharing a palette color.
+	 * NodeGroups maps each input node to a group in [0, NumGroups), or INDEX_NONE to keep its own color; those all end
+	 * up in FixedColors, however many colors they have. Any recoloring of the groups is then a cheap weighted sum per pixel
+	 * (see ResolveGroupColors) instead of another rasterization; meant for small previews.
+	 */
+	void RasterizeGroupWeights(FIntPoint Size, TArrayView<const int32> NodeGroups, int32 NumGroups, FTerrainGroupWeights& Out) const;
+
+	/** Color map of GroupWeights with each group colored GroupColors[Group]; matches a Rasterize of the recolored nodes */
+	static void ResolveGroupColors(const FTerrainGroupWeights& GroupWeights, TArrayView<const FLinearColor> GroupColors, TArrayView<FColor> OutPixels);
+
+	/**
+	 * Re-rasterizes just the pixels of Region within a Size image, e.g. the area touched by an edit.
+	 * OutPixels is row-major and Region sized; results match the same pixels of a full Rasterize.
+	 */
+	void RasterizeRegion(FIntPoint Size, const FIntRect& Region, TArrayView<FColor> OutPixels) const;
+
+	/**
+	 * Rasterizes only rows [RowBegin, RowEnd) of a Size image, as normalized linear colors, on the calling thread.
+	 * OutRows holds (RowEnd - RowBegin) * Size.X entries; used to produce large images piece by piece.
+	 */
+	void RasterizeBand(FIntPoint Size, int32 RowBegin, int32 RowEnd, TArrayView<FLinearColor> OutRows) const;
+
+	/** Exact radius in UV space outside of which the node contributes nothing */
+	static float GetSupportRadius(const FTerrainGraphNode& Node);
+
+	/** Pixels of a Size image the node can contribute to, clipped to the image */
+	static FIntRect GetPixelBounds(const FTerrainGraphNode& Node, FIntPoint Size);
+
+	/** Number of rows processed together; nodes are culled and heightmap tiles taken once per band */
+	static constexpr int32 BandHeight{ 32 };
+
+	/** Largest vertical downsampling ratio; bands grow to a multiple of it */
+	static constexpr int32 MaxDownsampleRatio{ 64 };
+
+	/** Splat indices are stored in 8 bits */
+	static constexpr int32 MaxLayers{ 256 };
+
+private:
+	/** Per-row scratch & inputs shared by all nodes of a row */
+	struct FRowContext
+	{
+		int32 Y{};
+		// Columns [XBegin, XEnd) being rasterized
+		int32 XBegin{};
+		int32 XEnd{};
+		TArrayView<FLinearColor> Color;
+		// Size.X * NumLayers, only when accumulating layers
+		TArrayView<float> Layers;
+		// Size.X each, only when masking
+		TArrayView<const float> Heights;
+		TArrayView<const float> Slopes;
+		// Size.X each, only when debugging
+		TArrayView<int32> NodeCounts;
+		TArrayView<int32> DominantSlot;
+		TArrayView<float> DominantWeight;
+		// Per band node, only when debugging
+		TArrayView<int64> SlotPixels;
+	};
+
+	/** One band's share of a debug rasterization, merged into FTerrainRasterStats afterwards */
+	struct FDebugBand
+	{
+		const FTerrainRasterDebugOutput* Output{};
+		TArray<int32> Nodes;
+		// Per entry of Nodes
+		TArray<int64> NodePixels;
+		TArray<int64> NodeDominantPixels;
+		int64 TotalNodesPerPixel{};
+		int32 MaxNodesPerPixel{};
+		int64 ClippedPixels{};
+	};
+
+	TArray<FPreparedTerrainNode> PreparedNodes;
+	int32 NumSourceNodes{};
+	ETerrainFalloff Falloff;
+	int32 NumLayers{};
+
+	TSharedPtr<const FTerrainHeightmap> Heightmap;
+	float MaskBlend{};
+
+	TSharedPtr<FTerrainBandScratchPool, ESPMode::ThreadSafe> ScratchPool;
+
+	/**
+	 * Accumulates the rows of Region one at a time, handing each un-normalized color row to RowSink(Y, Row).
+	 * Rows are Size.X wide, but only Region's columns are filled. With Debug, also collects the band's diagnostics.
+	 * A RowSink taking a third argument also gets the row's layer weights, Size.X * NumLayers.
+	 */
+	template<typename TRowSink>
+	void ProcessBand(
+		FIntPoint Size, const FIntRect& Region, const FTerrainSplatOutput* OutSplat, TRowSink&& RowSink,
+		const TArray<int32>* SharedBandNodes = nullptr, FDebugBand* Debug = nullptr) const;
+
+	/** Collects all nodes whose support overlaps Region */
+	void GatherBandNodes(FIntPoint Size, const FIntRect& Region, TArray<int32>& OutNodes) const;
+
+	/** Collects all nodes whose support overlaps the UV rectangle [UVMin, UVMax] */
+	void GatherNodes(FVector2f UVMin, FVector2f UVMax, TArray<int32>& OutNodes) const;
+
+	/**
+	 * Adds the un-normalized weighted color of every node in BandNodes to the row.
+	 * Layer weights, masks & debug counters are handled if Row has the views for them.
+	 */
+	void AccumulateRow(FIntPoint Size, const TArray<int32>& BandNodes, const FRowContext& Row) const;
+
+	template<bool bWithLayers, bool bWithMasks, bool bWithDebug>
+	void AccumulateRowKernel(FIntPoint Size, const TArray<int32>& BandNodes, const FRowContext& Row) const;
+
+	template<ETerrainFalloff Kernel, bool bWithLayers, bool bWithMasks, bool bWithDebug>
+	void AccumulateRowImpl(FIntPoint Size, const TArray<int32>& BandNodes, const FRowContext& Row) const;
+
+	/** Soft [0, 1] membership of Value in Range within [0, DomainMax], with inner edges Blend wide */
+	static float RangeMask(float Value, FVector2f Range, float DomainMax, float Blend);
+
+	/** Picks the 4 strongest of NumLayers layer weights and packs them */
+	void PackTopLayers(const float* LayerWeights, FColor& OutIndices, FColor& OutWeights) const;
+};
@@ -0,0 +1,164 @@
+#include "TerrainGraphAsset.h"
+
+#include "UObject/AssetRegistryTagsContext.h"
+
+namespace
+{
+	/** FTerrainGraphNode as saved by EVersion::Initial */
+	struct FTerrainGraphNodeInitial
+	{
+		FVector2f UVCoordinates;
+		FLinearColor Color;
+		float Intensity;
+		float DistanceModifier;
+		int32 TextureLayer;
+		FVector2f HeightRange;
+		FVector2f SlopeRange;
+	};
+
+	// Fires when the node's layout changes: add an EVersion, freeze the new layout next to the old ones and upgrade those in LoadNodes.
+	// Nodes are copied as raw memory, so every member has to stay where it was, with the same type
+	static_assert(sizeof(FTerrainGraphNode) == sizeof(FTerrainGraphNodeInitial), "FTerrainGraphNode's saved layout changed");
+#define CHECK_SAVED_NODE_MEMBER(Member) \
+	static_assert(STRUCT_OFFSET(FTerrainGraphNode, Member) == STRUCT_OFFSET(FTerrainGraphNodeInitial, Member) && \
+		std::is_same_v<decltype(FTerrainGraphNode::Member), decltype(FTerrainGraphNodeInitial::Member)>, \
+		"FTerrainGraphNode's saved layout changed: " #Member " moved or changed type");
+	CHECK_SAVED_NODE_MEMBER(UVCoordinates)
+	CHECK_SAVED_NODE_MEMBER(Color)
+	CHECK_SAVED_NODE_MEMBER(Intensity)
+	CHECK_SAVED_NODE_MEMBER(DistanceModifier)
+	CHECK_SAVED_NODE_MEMBER(TextureLayer)
+	CHECK_SAVED_NODE_MEMBER(HeightRange)
+	CHECK_SAVED_NODE_MEMBER(SlopeRange)
+#undef CHECK_SAVED_NODE_MEMBER
+
+	/**
+	 * Serializes Array as its element size, count and raw memory in one go.
+	 * The element size guards against loading data written with a different struct layout.
+	 * This asset only exists in the editor, so byte order never differs between save & load.
+	 */
+	template<typename T>
+	void SerializePackedArray(FArchive& Ar, TArray<T>& Array)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Packed arrays are copied as raw memory");
+
+		int32 elementSize{ sizeof(T) };
+		int32 num{ Array.Num() };
+		Ar << elementSize << num;
+
+		if (Ar.IsLoading())
+		{
+			// A corrupt count must not get as far as allocating; the data can't be larger than what's left to read
+			const int64 bytes{ static_cast<int64>(num) * elementSize };
+			const int64 remaining{ Ar.TotalSize() - Ar.Tell() };
+			if (elementSize != sizeof(T) || num < 0 || (Ar.TotalSize() >= 0 && bytes > remaining))
+			{
+				Ar.SetError();
+				return;
+			}
+			Array.SetNumUninitialized(num);
+		}
+
+		Ar.Serialize(Array.GetData(), static_cast<int64>(num) * sizeof(T));
+	}
+
+	/** Loads an array saved with an older element layout, upgrading each element */
+	template<typename TStored, typename T, typename TUpgrade>
+	void LoadUpgradedArray(FArchive& Ar, TArray<T>& Array, TUpgrade&& Upgrade)
+	{
+		TArray<TStored> stored;
+		SerializePackedArray(Ar, stored);
+		if (Ar.IsError()) return;
+
+		Array.Reset(stored.Num());
+		for (const TStored& element : stored)
+		{
+			Array.Add(Upgrade(element));
+		}
+	}
+}
+
+void UTerrainGraphAsset::ClampConnections()
+{
+	for (FTerrainGraphConnection& conn : TerrainMapConnections)
+	{
+		if (conn.Element1 < 0) conn.Element1 = 0;
+		else if (conn.Element1 >= GenerationData.Num()) conn.Element1 = GenerationData.Num() - 1;
+
+		if (conn.Element2 < 0) conn.Element2 = 0;
+		else if (conn.Element2 >= GenerationData.Num()) conn.Element2 = GenerationData.Num() - 1;
+	}
+}
+
+void UTerrainGraphAsset::NotifyGraphChanged(FName ChangedMember)
+{
+	MarkPackageDirty();
+	OnGraphChanged.Broadcast(ChangedMember, INDEX_NONE, EPropertyChangeType::Unspecified);
+}
+
+void UTerrainGraphAsset::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	// Reference collectors have nothing to find in the packed arrays.
+	// Transactions would snapshot the whole graph on every details view edit; FTerrainGraphHistory undoes those instead
+	if (Ar.IsObjectReferenceCollector() || Ar.IsTransacting()) return;
+
+	int32 version{ static_cast<int32>(EVersion::Latest) };
+	Ar << version;
+	if (Ar.IsLoading() && version > static_cast<int32>(EVersion::Latest))
+	{
+		Ar.SetError();
+		return;
+	}
+
+	if (Ar.IsLoading())
+	{
+		LoadNodes(Ar, static_cast<EVersion>(version));
+	}
+	else
+	{
+		SerializePackedArray(Ar, GenerationData);
+	}
+	SerializePackedArray(Ar, TerrainMapConnections);
+	SerializePackedArray(Ar, TerrainColorSet);
+}
+
+void UTerrainGraphAsset::LoadNodes(FArchive& Ar, EVersion Version)
+{
+	switch (Version)
+	{
+	case EVersion::Latest:
+		SerializePackedArray(Ar, GenerationData);
+		break;
+	// Older versions get a case each, loading their frozen layout through LoadUpgradedArray
+	default:
+		Ar.SetError();
+		break;
+	}
+}
+
+void UTerrainGraphAsset::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	if (!PropertyChangedEvent.MemberProperty) return;
+
+	const FName changed{ PropertyChangedEvent.MemberProperty->GetFName() };
+	if (changed == GET_MEMBER_NAME_CHECKED(ThisClass, TerrainMapConnections))
+	{
+		ClampConnections();
+	}
+
+	OnGraphChanged.Broadcast(changed, PropertyChangedEvent.GetArrayIndex(changed.ToString()), PropertyChangedEvent.ChangeType);
+}
+
+void UTerrainGraphAsset::GetAssetRegistryTags(FAssetRegistryTagsContext Context) const
+{
+	Super::GetAssetRegistryTags(Context);
+
+	// Lightweight summary shown in the content browser without loading the graph
+	Context.AddTag(FAssetRegistryTag(TEXT("Nodes"), FString::FromInt(GenerationData.Num()), FAssetRegistryTag::TT_Numerical));
+	Context.AddTag(FAssetRegistryTag(TEXT("Connections"), FString::FromInt(TerrainMapConnections.Num()), FAssetRegistryTag::TT_Numerical));
+	Context.AddTag(FAssetRegistryTag(TEXT("Colors"), FString::FromInt(TerrainColorSet.Num()), FAssetRegistryTag::TT_Numerical));
+}
@@ -0,0 +1,15 @@
+#include "TerrainGraphAssetFactory.h"
+
+#include "TerrainGraphAsset.h"
+
+UTerrainGraphAssetFactory::UTerrainGraphAssetFactory()
+{
+	SupportedClass = UTerrainGraphAsset::StaticClass();
+	bCreateNew = true;
+	bEditAfterNew = true;
+}
+
+UObject* UTerrainGraphAssetFactory::FactoryCreateNew(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, UObject* Context, FFeedbackContext* Warn)
+{
+	return NewObject<UTerrainGraphAsset>(InParent, InClass, InName, Flags);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Factories/Factory.h"
+#include "TerrainGraphAssetFactory.generated.h"
+
+/** Lets terrain graph assets be created from the content browser */
+UCLASS()
+class UTerrainGraphAssetFactory : public UFactory
+{
+	GENERATED_BODY()
+
+public:
+	UTerrainGraphAssetFactory();
+
+	virtual UObject* FactoryCreateNew(UClass* InClass, UObject* InParent, FName InName, EObjectFlags Flags, UObject* Context, FFeedbackContext* Warn) override;
+};
@@ -0,0 +1,215 @@
+#include "TerrainGraphHistory.h"
+
+#include "TerrainGraphAsset.h"
+
+namespace
+{
+	bool IsSameElement(const FTerrainGraphNode& A, const FTerrainGraphNode& B)
+	{
+		return A == B;
+	}
+
+	// Connections compare equal in either direction, but the history has to restore them exactly
+	bool IsSameElement(const FTerrainGraphConnection& A, const FTerrainGraphConnection& B)
+	{
+		return A.Element1 == B.Element1 && A.Element2 == B.Element2;
+	}
+
+	/** Whether every delta's index is in range when applied (or reverted) in order to an array of Num elements */
+	template<typename T>
+	bool CanApplyDeltas(int32 Num, const TArray<TTerrainGraphElementDelta<T>>& Deltas, bool bRevert)
+	{
+		for (int32 i{}; i < Deltas.Num(); ++i)
+		{
+			const TTerrainGraphElementDelta<T>& delta{ Deltas[bRevert ? Deltas.Num() - 1 - i : i] };
+			const bool isInsert{ !(bRevert ? delta.After : delta.Before).IsSet() };
+			const bool isRemove{ !(bRevert ? delta.Before : delta.After).IsSet() };
+
+			if (delta.Index < 0 || delta.Index > Num || (!isInsert && delta.Index == Num)) return false;
+			Num += isInsert ? 1 : isRemove ? -1 : 0;
+		}
+		return true;
+	}
+
+	/** Applies Deltas to Array in order, or reverts them in reverse order */
+	template<typename T>
+	void ApplyDeltas(TArray<T>& Array, const TArray<TTerrainGraphElementDelta<T>>& Deltas, bool bRevert)
+	{
+		for (int32 i{}; i < Deltas.Num(); ++i)
+		{
+			const TTerrainGraphElementDelta<T>& delta{ Deltas[bRevert ? Deltas.Num() - 1 - i : i] };
+			const TOptional<T>& from{ bRevert ? delta.After : delta.Before };
+			const TOptional<T>& to{ bRevert ? delta.Before : delta.After };
+
+			if (!from.IsSet()) Array.Insert(to.GetValue(), delta.Index);
+			else if (!to.IsSet()) Array.RemoveAt(delta.Index);
+			else Array[delta.Index] = to.GetValue();
+		}
+	}
+
+	/**
+	 * Collects the deltas turning Committed into Current.
+	 * A single added, removed or set element (as reported by the property change) is taken as is;
+	 * anything else compares element by element, with size changes at the end.
+	 */
+	template<typename T>
+	void DiffArray(
+		const TArray<T>& Committed, const TArray<T>& Current, int32 ArrayIndex, EPropertyChangeType::Type ChangeType,
+		TArray<TTerrainGraphElementDelta<T>>& OutDeltas)
+	{
+		const int32 numAdded{ Current.Num() - Committed.Num() };
+		if (ArrayIndex != INDEX_NONE)
+		{
+			const bool isAdd{ (ChangeType & (EPropertyChangeType::ArrayAdd | EPropertyChangeType::Duplicate)) != 0 };
+			const bool isRemove{ (ChangeType & EPropertyChangeType::ArrayRemove) != 0 };
+			const bool isSet{ (ChangeType & (EPropertyChangeType::ValueSet | EPropertyChangeType::ResetToDefault)) != 0 };
+
+			if (isAdd && numAdded == 1 && Current.IsValidIndex(ArrayIndex))
+			{
+				OutDeltas.Add({ ArrayIndex, {}, Current[ArrayIndex] });
+				return;
+			}
+			if (isRemove && numAdded == -1 && Committed.IsValidIndex(ArrayIndex))
+			{
+				OutDeltas.Add({ ArrayIndex, Committed[ArrayIndex], {} });
+				return;
+			}
+			if (isSet && numAdded == 0 && Current.IsValidIndex(ArrayIndex))
+			{
+				if (!IsSameElement(Committed[ArrayIndex], Current[ArrayIndex]))
+				{
+					OutDeltas.Add({ ArrayIndex, Committed[ArrayIndex], Current[ArrayIndex] });
+				}
+				return;
+			}
+		}
+
+		const int32 numCommon{ FMath::Min(Committed.Num(), Current.Num()) };
+		for (int32 i{}; i < numCommon; ++i)
+		{
+			if (!IsSameElement(Committed[i], Current[i]))
+			{
+				OutDeltas.Add({ i, Committed[i], Current[i] });
+			}
+		}
+
+		// Removed back to front and inserted front to back, so every index is valid when applied in order
+		for (int32 i{ Committed.Num() - 1 }; i >= numCommon; --i)
+		{
+			OutDeltas.Add({ i, Committed[i], {} });
+		}
+		for (int32 i{ numCommon }; i < Current.Num(); ++i)
+		{
+			OutDeltas.Add({ i, {}, Current[i] });
+		}
+	}
+}
+
+void FTerrainGraphHistory::Reset(const UTerrainGraphAsset& Asset)
+{
+	CommittedNodes = Asset.GenerationData;
+	CommittedConnections = Asset.TerrainMapConnections;
+	CommittedColorSet = Asset.TerrainColorSet;
+	Transactions.Reset();
+	NumApplied = 0;
+}
+
+const FTerrainGraphTransaction* FTerrainGraphHistory::Commit(
+	const UTerrainGraphAsset& Asset, FName Member, const FString& Description, int32 ArrayIndex, EPropertyChangeType::Type ChangeType)
+{
+	const bool commitNodes{ Member.IsNone() || Member == GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, GenerationData) };
+	const bool commitConnections{ Member.IsNone() || Member == GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, TerrainMapConnections) };
+	const bool commitColorSet{ Member.IsNone() || Member == GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, TerrainColorSet) };
+
+	// A hint only ever describes the one member it came with
+	if (Member.IsNone()) ArrayIndex = INDEX_NONE;
+
+	FTerrainGraphTransaction transaction{ Description };
+	if (commitNodes) DiffArray(CommittedNodes, Asset.GenerationData, ArrayIndex, ChangeType, transaction.Nodes);
+	if (commitConnections) DiffArray(CommittedConnections, Asset.TerrainMapConnections, ArrayIndex, ChangeType, transaction.Connections);
+	if (commitColorSet && CommittedColorSet != Asset.TerrainColorSet)
+	{
+		transaction.ChangesColorSet = true;
+		transaction.ColorSetBefore = CommittedColorSet;
+		transaction.ColorSetAfter = Asset.TerrainColorSet;
+	}
+	if (transaction.IsEmpty()) return nullptr;
+
+	ApplyDeltas(CommittedNodes, transaction.Nodes, false);
+	ApplyDeltas(CommittedConnections, transaction.Connections, false);
+	if (transaction.ChangesColorSet) CommittedColorSet = transaction.ColorSetAfter;
+
+	// A new edit discards everything that could have been redone
+	Transactions.SetNum(NumApplied);
+	if (Transactions.Num() == MaxTransactions)
+	{
+		Transactions.RemoveAt(0);
+	}
+	Transactions.Add(MoveTemp(transaction));
+	NumApplied = Transactions.Num();
+
+	return &Transactions.Last();
+}
+
+bool FTerrainGraphHistory::CanStep(const UTerrainGraphAsset& Asset, const FTerrainGraphTransaction& Transaction, bool bRevert)
+{
+	const bool canStep{
+		Asset.GenerationData.Num() == CommittedNodes.Num() && Asset.TerrainMapConnections.Num() == CommittedConnections.Num() &&
+		(!Transaction.ChangesColorSet || Asset.TerrainColorSet == CommittedColorSet) &&
+		CanApplyDeltas(CommittedNodes.Num(), Transaction.Nodes, bRevert) &&
+		CanApplyDeltas(CommittedConnections.Num(), Transaction.Connections, bRevert) };
+
+	// The asset was changed behind the history's back; what's recorded no longer applies to it
+	if (!canStep)
+	{
+		Reset(Asset);
+	}
+	return canStep;
+}
+
+const FTerrainGraphTransaction* FTerrainGraphHistory::Undo(UTerrainGraphAsset& Asset)
+{
+	if (!CanUndo() || !CanStep(Asset, Transactions[NumApplied - 1], true)) return nullptr;
+
+	// Connections were applied after the nodes, so they're reverted first
+	const FTerrainGraphTransaction& transaction{ Transactions[--NumApplied] };
+	ApplyDeltas(Asset.TerrainMapConnections, transaction.Connections, true);
+	ApplyDeltas(Asset.GenerationData, transaction.Nodes, true);
+	ApplyDeltas(CommittedConnections, transaction.Connections, true);
+	ApplyDeltas(CommittedNodes, transaction.Nodes, true);
+	if (transaction.ChangesColorSet)
+	{
+		Asset.TerrainColorSet = transaction.ColorSetBefore;
+		CommittedColorSet = transaction.ColorSetBefore;
+	}
+
+	return &transaction;
+}
+
+const FTerrainGraphTransaction* FTerrainGraphHistory::Redo(UTerrainGraphAsset& Asset)
+{
+	if (!CanRedo() || !CanStep(Asset, Transactions[NumApplied], false)) return nullptr;
+
+	const FTerrainGraphTransaction& transaction{ Transactions[NumApplied++] };
+	ApplyDeltas(Asset.GenerationData, transaction.Nodes, false);
+	ApplyDeltas(Asset.TerrainMapConnections, transaction.Connections, false);
+	ApplyDeltas(CommittedNodes, transaction.Nodes, false);
+	ApplyDeltas(CommittedConnections, transaction.Connections, false);
+	if (transaction.ChangesColorSet)
+	{
+		Asset.TerrainColorSet = transaction.ColorSetAfter;
+		CommittedColorSet = transaction.ColorSetAfter;
+	}
+
+	return &transaction;
+}
+
+FString FTerrainGraphHistory::GetUndoDescription() const
+{
+	return CanUndo() ? Transactions[NumApplied - 1].Description : FString{};
+}
+
+FString FTerrainGraphHistory::GetRedoDescription() const
+{
+	return CanRedo() ? Transactions[NumApplied].Description : FString{};
+}
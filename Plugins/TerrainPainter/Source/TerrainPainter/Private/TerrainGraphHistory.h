@@ -0,0 +1,80 @@
+#pragma once
+
+#include "GraphHelpers.h"
+
+class UTerrainGraphAsset;
+
+/** Before & after of one array element; no Before means it was inserted at Index, no After that it was removed from there */
+template<typename T>
+struct TTerrainGraphElementDelta
+{
+	int32 Index{};
+	TOptional<T> Before;
+	TOptional<T> After;
+};
+
+/** One undoable edit, holding only the elements it touched, in the order they were applied */
+struct FTerrainGraphTransaction
+{
+	FString Description;
+	TArray<TTerrainGraphElementDelta<FTerrainGraphNode>> Nodes;
+	TArray<TTerrainGraphElementDelta<FTerrainGraphConnection>> Connections;
+
+	// The palette is only a handful of colors, so it's recorded whole when an edit changes it
+	bool ChangesColorSet{};
+	TArray<FLinearColor> ColorSetBefore;
+	TArray<FLinearColor> ColorSetAfter;
+
+	bool IsEmpty() const { return Nodes.IsEmpty() && Connections.IsEmpty() && !ChangesColorSet; }
+};
+
+/**
+ * Undo & redo of a graph's nodes & connections as per-element deltas, and of its palette.
+ * This is all the undo the graph has; engine transactions leave it out.
+ * A copy of the last committed state is kept to find out what an edit changed; property edits tell which element
+ * they touched, so those only compare that one element, and no edit ever snapshots the graph.
+ */
+class FTerrainGraphHistory
+{
+public:
+	/** Drops all transactions and starts over from Asset's current state; undo & redo expect Asset to match the last commit */
+	void Reset(const UTerrainGraphAsset& Asset);
+
+	/**
+	 * Records the changes made to Member (all of the graph for NAME_None) since the last commit as a transaction.
+	 * ArrayIndex & ChangeType come from the property change event, if any; without them the whole array is compared.
+	 * @return the recorded transaction, or nullptr if nothing changed
+	 */
+	const FTerrainGraphTransaction* Commit(
+		const UTerrainGraphAsset& Asset, FName Member, const FString& Description,
+		int32 ArrayIndex = INDEX_NONE, EPropertyChangeType::Type ChangeType = EPropertyChangeType::Unspecified);
+
+	/**
+	 * Reverts the latest transaction on Asset; returns it, or nullptr if there is nothing to undo.
+	 * If Asset no longer matches the last commit, the history is reset instead and nullptr returned.
+	 */
+	const FTerrainGraphTransaction* Undo(UTerrainGraphAsset& Asset);
+
+	/** Re-applies the latest undone transaction on Asset; returns it, or nullptr if there is nothing to redo (or on a mismatch, as Undo) */
+	const FTerrainGraphTransaction* Redo(UTerrainGraphAsset& Asset);
+
+	bool CanUndo() const { return NumApplied > 0; }
+	bool CanRedo() const { return NumApplied < Transactions.Num(); }
+	FString GetUndoDescription() const;
+	FString GetRedoDescription() const;
+
+	/** Oldest transactions are dropped beyond this */
+	static constexpr int32 MaxTransactions{ 256 };
+
+private:
+	/** Whether Transaction can be stepped on Asset & the committed state; resets the history if not */
+	bool CanStep(const UTerrainGraphAsset& Asset, const FTerrainGraphTransaction& Transaction, bool bRevert);
+
+	TArray<FTerrainGraphNode> CommittedNodes;
+	TArray<FTerrainGraphConnection> CommittedConnections;
+	TArray<FLinearColor> CommittedColorSet;
+
+	// Transactions [0, NumApplied) are applied, the rest have been undone and can be redone
+	TArray<FTerrainGraphTransaction> Transactions;
+	int32 NumApplied{};
+};
@@ -0,0 +1,211 @@
+#include "TerrainGraphImporter.h"
+
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+
+namespace
+{
+	constexpr int32 MaxFields{ 8 };
+
+	/** Whether Field is a whole decimal number: an optional sign, digits with an optional point, and an optional exponent */
+	bool IsNumber(const ANSICHAR* Field)
+	{
+		const auto skipDigits{ [&Field]()
+		{
+			int32 numDigits{};
+			for (; *Field >= '0' && *Field <= '9'; ++Field) ++numDigits;
+			return numDigits;
+		} };
+
+		if (*Field == '-' || *Field == '+') ++Field;
+		int32 numDigits{ skipDigits() };
+		if (*Field == '.')
+		{
+			++Field;
+			numDigits += skipDigits();
+		}
+		if (numDigits == 0) return false;
+
+		if (*Field == 'e' || *Field == 'E')
+		{
+			++Field;
+			if (*Field == '-' || *Field == '+') ++Field;
+			if (skipDigits() == 0) return false;
+		}
+		return *Field == '\0';
+	}
+
+	/**
+	 * Splits [Begin, End) at commas and parses each field as a number.
+	 * Every field is stored as a float or an int32 in the end, so values a float can't hold fail the line.
+	 */
+	int32 ParseFields(const ANSICHAR* Begin, const ANSICHAR* End, double (&OutFields)[MaxFields])
+	{
+		int32 numFields{};
+		const ANSICHAR* fieldBegin{ Begin };
+		while (fieldBegin <= End)
+		{
+			const ANSICHAR* fieldEnd{ fieldBegin };
+			while (fieldEnd < End && *fieldEnd != ',') ++fieldEnd;
+
+			if (numFields == MaxFields) return -1;
+
+			// Copy into a terminated buffer, skipping whitespace; anything else non-numeric fails the line
+			ANSICHAR field[64];
+			int32 length{};
+			for (const ANSICHAR* c{ fieldBegin }; c < fieldEnd; ++c)
+			{
+				if (*c == ' ' || *c == '\t' || *c == '"') continue;
+				const bool isNumeric{ (*c >= '0' && *c <= '9') || *c == '.' || *c == '-' || *c == '+' || *c == 'e' || *c == 'E' };
+				if (!isNumeric || length == UE_ARRAY_COUNT(field) - 1) return -1;
+				field[length++] = *c;
+			}
+			field[length] = '\0';
+			if (!IsNumber(field)) return -1;
+
+			const double value{ FCStringAnsi::Atod(field) };
+			if (!FMath::IsFinite(value) || FMath::Abs(value) > MAX_flt) return -1;
+			OutFields[numFields++] = value;
+			fieldBegin = fieldEnd + 1;
+		}
+		return numFields;
+	}
+
+	bool ParseNode(const ANSICHAR* Begin, const ANSICHAR* End, FTerrainGraphNode& OutNode)
+	{
+		double fields[MaxFields];
+		const int32 numFields{ ParseFields(Begin, End, fields) };
+		if (numFields != 7 && numFields != 8) return false;
+
+		OutNode.UVCoordinates = { static_cast<float>(fields[0]), static_cast<float>(fields[1]) };
+		OutNode.Color = FLinearColor(static_cast<float>(fields[2]), static_cast<float>(fields[3]), static_cast<float>(fields[4]));
+		OutNode.Intensity = static_cast<float>(fields[5]);
+		OutNode.DistanceModifier = static_cast<float>(fields[6]);
+		OutNode.TextureLayer = numFields == 8 ? static_cast<int32>(FMath::Clamp(fields[7], 0.0, 255.0)) : 0;
+		return true;
+	}
+
+	bool ParseConnection(const ANSICHAR* Begin, const ANSICHAR* End, FTerrainGraphConnection& OutConnection)
+	{
+		double fields[MaxFields];
+		if (ParseFields(Begin, End, fields) != 2) return false;
+
+		// Indices have to be whole numbers an int32 can hold
+		for (int32 i{}; i < 2; ++i)
+		{
+			if (fields[i] != FMath::FloorToDouble(fields[i]) || fields[i] < MIN_int32 || fields[i] > MAX_int32) return false;
+		}
+
+		OutConnection.Element1 = static_cast<int32>(fields[0]);
+		OutConnection.Element2 = static_cast<int32>(fields[1]);
+		return true;
+	}
+
+	/**
+	 * Streams FilePath chunk by chunk; each chunk is cut at its last line end (the remainder carries over
+	 * to the next one), split into slices at line ends and the slices are parsed in parallel.
+	 * Slice results are appended in order, so elements keep their order from the file.
+	 */
+	template<typename TElement, typename TParseLine>
+	bool StreamParseCsv(const FString& FilePath, TArray<TElement>& OutElements, int32& OutSkippedLines, FString& OutError, TParseLine ParseLine)
+	{
+		const TUniquePtr<FArchive> reader{ IFileManager::Get().CreateFileReader(*FilePath) };
+		if (!reader)
+		{
+			OutError = FString::Printf(TEXT("Failed to open '%s'."), *FilePath);
+			return false;
+		}
+
+		OutElements.Reset();
+		OutSkippedLines = 0;
+
+		const int64 fileSize{ reader->TotalSize() };
+		int64 offset{};
+
+		TArray<ANSICHAR> buffer;
+		TArray<TPair<int32, int32>> slices;
+		TArray<TArray<TElement>> sliceElements;
+		TArray<int32> sliceSkipped;
+
+		while (offset < fileSize)
+		{
+			// Append the next chunk behind whatever partial line carried over
+			const int64 toRead{ FMath::Min(FTerrainGraphImporter::ChunkSize, fileSize - offset) };
+			const int32 carried{ buffer.Num() };
+			buffer.SetNumUninitialized(carried + static_cast<int32>(toRead), EAllowShrinking::No);
+			reader->Serialize(buffer.GetData() + carried, toRead);
+			offset += toRead;
+
+			int32 parseEnd{ buffer.Num() };
+			if (offset < fileSize)
+			{
+				while (parseEnd > 0 && buffer[parseEnd - 1] != '\n') --parseEnd;
+				// A single line longer than a chunk; keep reading until it's complete
+				if (parseEnd == 0) continue;
+			}
+
+			slices.Reset();
+			int32 sliceBegin{};
+			while (sliceBegin < parseEnd)
+			{
+				int32 sliceEnd{ FMath::Min(sliceBegin + static_cast<int32>(FTerrainGraphImporter::SliceSize), parseEnd) };
+				while (sliceEnd < parseEnd && buffer[sliceEnd - 1] != '\n') ++sliceEnd;
+				slices.Emplace(sliceBegin, sliceEnd);
+				sliceBegin = sliceEnd;
+			}
+
+			sliceElements.SetNum(slices.Num());
+			sliceSkipped.SetNumZeroed(slices.Num());
+			ParallelFor(slices.Num(), [&](int32 sliceIndex)
+			{
+				TArray<TElement>& elements{ sliceElements[sliceIndex] };
+				elements.Reset();
+
+				const ANSICHAR* cursor{ buffer.GetData() + slices[sliceIndex].Key };
+				const ANSICHAR* sliceEndPtr{ buffer.GetData() + slices[sliceIndex].Value };
+				while (cursor < sliceEndPtr)
+				{
+					const ANSICHAR* lineEnd{ cursor };
+					while (lineEnd < sliceEndPtr && *lineEnd != '\n') ++lineEnd;
+
+					const ANSICHAR* contentEnd{ lineEnd };
+					if (contentEnd > cursor && *(contentEnd - 1) == '\r') --contentEnd;
+
+					if (contentEnd > cursor && *cursor != '#')
+					{
+						TElement element;
+						if (ParseLine(cursor, contentEnd, element))
+						{
+							elements.Add(element);
+						}
+						else
+						{
+							++sliceSkipped[sliceIndex];
+						}
+					}
+					cursor = lineEnd + 1;
+				}
+			});
+
+			for (int32 i{}; i < slices.Num(); ++i)
+			{
+				OutElements.Append(sliceElements[i]);
+				OutSkippedLines += sliceSkipped[i];
+			}
+
+			buffer.RemoveAt(0, parseEnd, EAllowShrinking::No);
+		}
+
+		return true;
+	}
+}
+
+bool FTerrainGraphImporter::ImportNodes(const FString& FilePath, TArray<FTerrainGraphNode>& OutNodes, int32& OutSkippedLines, FString& OutError)
+{
+	return StreamParseCsv(FilePath, OutNodes, OutSkippedLines, OutError, &ParseNode);
+}
+
+bool FTerrainGraphImporter::ImportConnections(const FString& FilePath, TArray<FTerrainGraphConnection>& OutConnections, int32& OutSkippedLines, FString& OutError)
+{
+	return StreamParseCsv(FilePath, OutConnections, OutSkippedLines, OutError, &ParseConnection);
+}
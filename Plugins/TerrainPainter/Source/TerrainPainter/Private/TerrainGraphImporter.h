@@ -0,0 +1,25 @@
+#pragma once
+
+#include "GraphHelpers.h"
+
+/**
+ * Bulk import of nodes & connections from CSV, e.g. exported from GIS or scatter tools.
+ * Files are streamed in fixed-size chunks, each chunk is split at line ends and parsed in parallel,
+ * so neither the whole file nor any per-element property notification is ever involved.
+ *
+ * Node rows:       u, v, r, g, b, intensity, distance modifier[, texture layer]
+ * Connection rows: node index, node index
+ * Empty lines and lines starting with '#' are ignored; lines that don't parse (e.g. a header) are skipped and counted.
+ */
+class FTerrainGraphImporter
+{
+public:
+	static bool ImportNodes(const FString& FilePath, TArray<FTerrainGraphNode>& OutNodes, int32& OutSkippedLines, FString& OutError);
+	static bool ImportConnections(const FString& FilePath, TArray<FTerrainGraphConnection>& OutConnections, int32& OutSkippedLines, FString& OutError);
+
+	/** Bytes read from disk at a time */
+	static constexpr int64 ChunkSize{ 16 * 1024 * 1024 };
+
+	/** Approximate bytes parsed per task within a chunk */
+	static constexpr int64 SliceSize{ 256 * 1024 };
+};
@@ -0,0 +1,155 @@
+#include "TerrainGraphSpatialIndex.h"
+
+void FTerrainGraphSpatialIndex::Build(TArrayView<const FTerrainGraphNode> Nodes, TArrayView<const FTerrainGraphConnection> Connections)
+{
+	Resolution = FMath::Clamp(FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(Nodes.Num()) / NodesPerCell)), 1, MaxResolution);
+
+	NodeUVs.SetNumUninitialized(Nodes.Num());
+	for (int32 i{}; i < Nodes.Num(); ++i)
+	{
+		NodeUVs[i] = Nodes[i].UVCoordinates;
+	}
+
+	const auto isValid{ [this, Connections](int32 connection)
+	{
+		const FTerrainGraphConnection& conn{ Connections[connection] };
+		return NodeUVs.IsValidIndex(conn.Element1) && NodeUVs.IsValidIndex(conn.Element2) && conn.Element1 != conn.Element2;
+	} };
+
+	// Invalid connections can't be picked; they still get a segment so indices keep matching the asset's array
+	Segments.SetNumUninitialized(Connections.Num());
+	for (int32 i{}; i < Connections.Num(); ++i)
+	{
+		Segments[i] = isValid(i)
+			? TPair<FVector2f, FVector2f>{ NodeUVs[Connections[i].Element1], NodeUVs[Connections[i].Element2] }
+			: TPair<FVector2f, FVector2f>{};
+	}
+
+	BuildCells(NodeUVs.Num(), [this](int32 node, auto&& visit)
+	{
+		const FIntPoint cell{ GetCell(NodeUVs[node]) };
+		visit(cell.Y * Resolution + cell.X);
+	}, NodeCells);
+
+	BuildCells(Segments.Num(), [this, &isValid](int32 segment, auto&& visit)
+	{
+		if (!isValid(segment)) return;
+		ForEachSegmentCell(Segments[segment].Key, Segments[segment].Value, visit);
+	}, SegmentCells);
+}
+
+int32 FTerrainGraphSpatialIndex::FindNode(FVector2f UV, float Radius) const
+{
+	return FindClosest(NodeCells, UV, Radius, [this, UV](int32 node)
+	{
+		return FVector2f::Distance(NodeUVs[node], UV);
+	});
+}
+
+int32 FTerrainGraphSpatialIndex::FindConnection(FVector2f UV, float Radius) const
+{
+	return FindClosest(SegmentCells, UV, Radius, [this, UV](int32 segment)
+	{
+		const FVector2f a{ Segments[segment].Key };
+		const FVector2f ab{ Segments[segment].Value - a };
+		const float lengthSq{ ab.SizeSquared() };
+		const float t{ lengthSq > 0.f ? FMath::Clamp(FVector2f::DotProduct(UV - a, ab) / lengthSq, 0.f, 1.f) : 0.f };
+		return FVector2f::Distance(a + ab * t, UV);
+	});
+}
+
+FIntPoint FTerrainGraphSpatialIndex::GetCell(FVector2f UV) const
+{
+	return {
+		FMath::Clamp(FMath::FloorToInt32(UV.X * Resolution), 0, Resolution - 1),
+		FMath::Clamp(FMath::FloorToInt32(UV.Y * Resolution), 0, Resolution - 1)
+	};
+}
+
+template<typename TVisit>
+void FTerrainGraphSpatialIndex::ForEachSegmentCell(FVector2f A, FVector2f B, TVisit&& Visit) const
+{
+	// Grid traversal (Amanatides & Woo) in cell units
+	const FVector2f start{ A * Resolution };
+	const FVector2f dir{ (B - A) * Resolution };
+	FIntPoint cell{ GetCell(A) };
+	const FIntPoint endCell{ GetCell(B) };
+
+	const FIntPoint step{ dir.X >= 0.f ? 1 : -1, dir.Y >= 0.f ? 1 : -1 };
+	const float tDeltaX{ dir.X != 0.f ? FMath::Abs(1.f / dir.X) : UE_BIG_NUMBER };
+	const float tDeltaY{ dir.Y != 0.f ? FMath::Abs(1.f / dir.Y) : UE_BIG_NUMBER };
+	float tMaxX{ dir.X != 0.f ? (cell.X + (step.X > 0 ? 1 : 0) - start.X) / dir.X : UE_BIG_NUMBER };
+	float tMaxY{ dir.Y != 0.f ? (cell.Y + (step.Y > 0 ? 1 : 0) - start.Y) / dir.Y : UE_BIG_NUMBER };
+
+	Visit(cell.Y * Resolution + cell.X);
+
+	// Bounded by the cells on the way, in case clamping put the end cell off the line
+	const int32 maxSteps{ FMath::Abs(endCell.X - cell.X) + FMath::Abs(endCell.Y - cell.Y) };
+	for (int32 i{}; i < maxSteps && cell != endCell; ++i)
+	{
+		if (tMaxX < tMaxY)
+		{
+			cell.X = FMath::Clamp(cell.X + step.X, 0, Resolution - 1);
+			tMaxX += tDeltaX;
+		}
+		else
+		{
+			cell.Y = FMath::Clamp(cell.Y + step.Y, 0, Resolution - 1);
+			tMaxY += tDeltaY;
+		}
+		Visit(cell.Y * Resolution + cell.X);
+	}
+}
+
+template<typename TForEachCell>
+void FTerrainGraphSpatialIndex::BuildCells(int32 NumItems, TForEachCell&& ForEachCell, FCells& OutCells) const
+{
+	const int32 numCells{ Resolution * Resolution };
+
+	// Count, prefix sum into start offsets, then scatter
+	OutCells.Start.SetNumZeroed(numCells + 1);
+	for (int32 item{}; item < NumItems; ++item)
+	{
+		ForEachCell(item, [&OutCells](int32 cell){ ++OutCells.Start[cell + 1]; });
+	}
+	for (int32 cell{}; cell < numCells; ++cell)
+	{
+		OutCells.Start[cell + 1] += OutCells.Start[cell];
+	}
+
+	OutCells.Items.SetNumUninitialized(OutCells.Start[numCells]);
+	TArray<int32> cursor{ OutCells.Start };
+	for (int32 item{}; item < NumItems; ++item)
+	{
+		ForEachCell(item, [&OutCells, &cursor, item](int32 cell){ OutCells.Items[cursor[cell]++] = item; });
+	}
+}
+
+template<typename TDistance>
+int32 FTerrainGraphSpatialIndex::FindClosest(const FCells& Cells, FVector2f UV, float Radius, TDistance&& Distance) const
+{
+	if (Resolution == 0) return INDEX_NONE;
+
+	const FIntPoint minCell{ GetCell(UV - FVector2f{ Radius }) };
+	const FIntPoint maxCell{ GetCell(UV + FVector2f{ Radius }) };
+
+	int32 closest{ INDEX_NONE };
+	float closestDistance{ Radius };
+	for (int32 y{ minCell.Y }; y <= maxCell.Y; ++y)
+	{
+		for (int32 x{ minCell.X }; x <= maxCell.X; ++x)
+		{
+			const int32 cell{ y * Resolution + x };
+			for (int32 i{ Cells.Start[cell] }; i < Cells.Start[cell + 1]; ++i)
+			{
+				const float distance{ Distance(Cells.Items[i]) };
+				if (distance <= closestDistance)
+				{
+					closest = Cells.Items[i];
+					closestDistance = distance;
+				}
+			}
+		}
+	}
+	return closest;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "GraphHelpers.h"
+
+/**
+ * Uniform grid over UV space for picking nodes & connections.
+ * The grid is sized to hold a few nodes per cell, so a pick only looks at the handful of cells around it,
+ * independent of graph size. Connections are registered in every cell their segment passes through.
+ * Cells are stored flattened (start offsets + items), so building is two linear passes without per-cell allocations.
+ */
+class FTerrainGraphSpatialIndex
+{
+public:
+	void Build(TArrayView<const FTerrainGraphNode> Nodes, TArrayView<const FTerrainGraphConnection> Connections);
+
+	/** Closest node within Radius of UV, or INDEX_NONE */
+	int32 FindNode(FVector2f UV, float Radius) const;
+
+	/** Closest connection within Radius of UV, or INDEX_NONE */
+	int32 FindConnection(FVector2f UV, float Radius) const;
+
+	/** Average nodes per cell the grid is sized for */
+	static constexpr int32 NodesPerCell{ 4 };
+	static constexpr int32 MaxResolution{ 1024 };
+
+private:
+	struct FCells
+	{
+		// Items of cell i are Items[Start[i], Start[i + 1])
+		TArray<int32> Start;
+		TArray<int32> Items;
+	};
+
+	int32 Resolution{};
+	TArray<FVector2f> NodeUVs;
+	TArray<TPair<FVector2f, FVector2f>> Segments;
+	FCells NodeCells;
+	FCells SegmentCells;
+
+	FIntPoint GetCell(FVector2f UV) const;
+
+	/** Calls Visit(CellIndex) for every cell the segment from A to B passes through */
+	template<typename TVisit>
+	void ForEachSegmentCell(FVector2f A, FVector2f B, TVisit&& Visit) const;
+
+	/** Counting sort of NumItems items into cells; ForEachCell(Item, Visit) reports an item's cells */
+	template<typename TForEachCell>
+	void BuildCells(int32 NumItems, TForEachCell&& ForEachCell, FCells& OutCells) const;
+
+	/** Closest item within Radius of UV among the cells around it, by Distance(Item) */
+	template<typename TDistance>
+	int32 FindClosest(const FCells& Cells, FVector2f UV, float Radius, TDistance&& Distance) const;
+};
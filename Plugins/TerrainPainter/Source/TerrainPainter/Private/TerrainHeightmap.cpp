@@ -0,0 +1,345 @@
+#include "TerrainHeightmap.h"
+
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
+
+THIRD_PARTY_INCLUDES_START
+#include "zlib.h"
+THIRD_PARTY_INCLUDES_END
+
+namespace
+{
+	uint32 ReadBigEndian32(const uint8* Bytes)
+	{
+		return static_cast<uint32>(Bytes[0]) << 24 | static_cast<uint32>(Bytes[1]) << 16 | static_cast<uint32>(Bytes[2]) << 8 | Bytes[3];
+	}
+
+	/** Header of a PNG file; the reader is left at the first chunk after IHDR */
+	struct FPngHeader
+	{
+		FIntPoint Resolution{};
+		uint8 BitDepth{};
+		uint8 ColorType{};
+		uint8 Interlace{};
+
+		bool Read(FArchive& Ar)
+		{
+			// Signature, then IHDR's length, type, 13 bytes of data & CRC
+			uint8 bytes[8 + 8 + 13 + 4];
+			Ar.Serialize(bytes, sizeof(bytes));
+			constexpr uint8 signature[8]{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			if (Ar.IsError() || FMemory::Memcmp(bytes, signature, 8) != 0 || ReadBigEndian32(bytes + 8) != 13 || FMemory::Memcmp(bytes + 12, "IHDR", 4) != 0)
+			{
+				return false;
+			}
+
+			const uint32 width{ ReadBigEndian32(bytes + 16) };
+			const uint32 height{ ReadBigEndian32(bytes + 20) };
+			if (width == 0 || height == 0 || width > MAX_int32 || height > MAX_int32) return false;
+
+			Resolution = { static_cast<int32>(width), static_cast<int32>(height) };
+			BitDepth = bytes[24];
+			ColorType = bytes[25];
+			Interlace = bytes[28];
+			return true;
+		}
+
+		/** Samples per pixel for the color types heightmaps can come in: gray, RGB, gray & alpha, RGBA; 0 for any other */
+		int32 GetNumChannels() const
+		{
+			switch (ColorType)
+			{
+			case 0: return 1;
+			case 2: return 3;
+			case 4: return 2;
+			case 6: return 4;
+			default: return 0;
+			}
+		}
+	};
+
+	uint8 PaethPredictor(uint8 Left, uint8 Up, uint8 UpLeft)
+	{
+		const int32 estimate{ Left + Up - UpLeft };
+		const int32 toLeft{ FMath::Abs(estimate - Left) };
+		const int32 toUp{ FMath::Abs(estimate - Up) };
+		const int32 toUpLeft{ FMath::Abs(estimate - UpLeft) };
+		if (toLeft <= toUp && toLeft <= toUpLeft) return Left;
+		return toUp <= toUpLeft ? Up : UpLeft;
+	}
+
+	/** Reverses the filter of one PNG row in place; Row starts with its filter byte, Previous is the unfiltered row above (zeroed for the first) */
+	bool Unfilter(TArrayView<uint8> Row, TArrayView<const uint8> Previous, int32 BytesPerPixel)
+	{
+		uint8* row{ Row.GetData() + 1 };
+		const uint8* up{ Previous.GetData() + 1 };
+		const int32 num{ Row.Num() - 1 };
+		switch (Row[0])
+		{
+		case 0:
+			break;
+		case 1:
+			for (int32 i{ BytesPerPixel }; i < num; ++i) row[i] += row[i - BytesPerPixel];
+			break;
+		case 2:
+			for (int32 i{}; i < num; ++i) row[i] += up[i];
+			break;
+		case 3:
+			for (int32 i{}; i < num; ++i) row[i] += static_cast<uint8>(((i >= BytesPerPixel ? row[i - BytesPerPixel] : 0) + up[i]) / 2);
+			break;
+		case 4:
+			for (int32 i{}; i < num; ++i)
+			{
+				row[i] += i >= BytesPerPixel ? PaethPredictor(row[i - BytesPerPixel], up[i], up[i - BytesPerPixel]) : up[i];
+			}
+			break;
+		default:
+			return false;
+		}
+		return true;
+	}
+}
+
+FTerrainHeightmapTile::FTerrainHeightmapTile(const uint16* heights, FIntPoint resolution, int32 firstRow, int32 numRows, FVector worldSize)
+	: Heights{ heights }
+	, Resolution{ resolution }
+	, FirstRow{ firstRow }
+	, NumRows{ numRows }
+	, WorldSize{ worldSize }
+{
+}
+
+float FTerrainHeightmapTile::GetHeight(int32 X, int32 Y) const
+{
+	// Clamp to the rows mapped for this tile; the tile is mapped with a one row margin, so this only kicks in at the image edges
+	const int32 x{ FMath::Clamp(X, 0, Resolution.X - 1) };
+	const int32 y{ FMath::Clamp(Y - FirstRow, 0, NumRows - 1) };
+	return Heights[y * Resolution.X + x] * (1.f / MAX_uint16);
+}
+
+float FTerrainHeightmapTile::SampleHeight(FVector2f UV) const
+{
+	const float fx{ UV.X * (Resolution.X - 1) };
+	const float fy{ UV.Y * (Resolution.Y - 1) };
+	const int32 x{ FMath::FloorToInt32(fx) };
+	const int32 y{ FMath::FloorToInt32(fy) };
+	const float tx{ fx - x };
+	const float ty{ fy - y };
+
+	const float top{ FMath::Lerp(GetHeight(x, y), GetHeight(x + 1, y), tx) };
+	const float bottom{ FMath::Lerp(GetHeight(x, y + 1), GetHeight(x + 1, y + 1), tx) };
+	return FMath::Lerp(top, bottom, ty);
+}
+
+float FTerrainHeightmapTile::SampleSlope(FVector2f UV) const
+{
+	const int32 x{ FMath::RoundToInt32(UV.X * (Resolution.X - 1)) };
+	const int32 y{ FMath::RoundToInt32(UV.Y * (Resolution.Y - 1)) };
+
+	// Central differences, converted from normalized height per texel to world height per world unit
+	const float texelSizeX{ static_cast<float>(WorldSize.X) / FMath::Max(1, Resolution.X - 1) };
+	const float texelSizeY{ static_cast<float>(WorldSize.Y) / FMath::Max(1, Resolution.Y - 1) };
+	const float dx{ (GetHeight(x + 1, y) - GetHeight(x - 1, y)) * static_cast<float>(WorldSize.Z) / (2.f * texelSizeX) };
+	const float dy{ (GetHeight(x, y + 1) - GetHeight(x, y - 1)) * static_cast<float>(WorldSize.Z) / (2.f * texelSizeY) };
+
+	return FMath::RadiansToDegrees(FMath::Atan(FMath::Sqrt(dx * dx + dy * dy)));
+}
+
+
+FTerrainHeightmap::~FTerrainHeightmap() = default;
+
+TSharedPtr<FTerrainHeightmap> FTerrainHeightmap::Open(const FString& FilePath, FIntPoint RawResolution, FVector worldSize, FString& OutError)
+{
+	if (!FPaths::FileExists(FilePath))
+	{
+		OutError = FString::Printf(TEXT("Heightmap '%s' does not exist."), *FilePath);
+		return nullptr;
+	}
+
+	FString rawPath{ FilePath };
+	FIntPoint resolution{ RawResolution };
+	if (FPaths::GetExtension(FilePath).Equals(TEXT("png"), ESearchCase::IgnoreCase))
+	{
+		if (!TryConvertPngToRaw(FilePath, rawPath, resolution, OutError)) return nullptr;
+	}
+
+	// Mapped once as a whole, so bands never map (and can't fail to map) rows of their own
+	TUniquePtr<IMappedFileHandle> handle{ FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*rawPath) };
+	TUniquePtr<IMappedFileRegion> region{ handle && handle->GetFileSize() > 0 ? handle->MapRegion(0, handle->GetFileSize()) : nullptr };
+	if (!region)
+	{
+		OutError = FString::Printf(TEXT("Failed to memory map heightmap '%s'."), *rawPath);
+		return nullptr;
+	}
+
+	const int64 numTexels{ handle->GetFileSize() / static_cast<int64>(sizeof(uint16)) };
+	if (resolution.X <= 0 || resolution.Y <= 0)
+	{
+		// Headerless RAW without a given resolution; only square heightmaps can be inferred
+		const int32 side{ static_cast<int32>(FMath::Sqrt(static_cast<double>(numTexels))) };
+		resolution = { side, side };
+	}
+
+	if (resolution.X < 2 || resolution.Y < 2 || static_cast<int64>(resolution.X) * resolution.Y != numTexels)
+	{
+		OutError = FString::Printf(TEXT("Heightmap '%s' is not a 16-bit heightmap of %dx%d."), *rawPath, resolution.X, resolution.Y);
+		return nullptr;
+	}
+
+	const TSharedPtr<FTerrainHeightmap> heightmap{ MakeShareable(new FTerrainHeightmap()) };
+	heightmap->Handle = MoveTemp(handle);
+	heightmap->Region = MoveTemp(region);
+	heightmap->Resolution = resolution;
+	heightmap->WorldSize = worldSize;
+	return heightmap;
+}
+
+FTerrainHeightmapTile FTerrainHeightmap::GetTile(int32 OutputHeight, int32 RowBegin, int32 RowEnd) const
+{
+	// Heightmap rows touched by bilinear sampling & central differences of the output rows, plus a row of margin each side
+	const float scale{ static_cast<float>(Resolution.Y - 1) / FMath::Max(1, OutputHeight) };
+	const int32 firstRow{ FMath::Max(0, FMath::FloorToInt32(RowBegin * scale) - 1) };
+	const int32 lastRow{ FMath::Min(Resolution.Y - 1, FMath::CeilToInt32((RowEnd - 1) * scale) + 2) };
+	const int32 numRows{ lastRow - firstRow + 1 };
+
+	const uint16* heights{ reinterpret_cast<const uint16*>(Region->GetMappedPtr()) + static_cast<int64>(firstRow) * Resolution.X };
+	return FTerrainHeightmapTile{ heights, Resolution, firstRow, numRows, WorldSize };
+}
+
+bool FTerrainHeightmap::TryConvertPngToRaw(const FString& PngPath, FString& OutRawPath, FIntPoint& OutResolution, FString& OutError)
+{
+	// PNG is compressed and can't be mapped; decode it once into a RAW cache that is reused until the PNG changes
+	OutRawPath = FPaths::Combine(
+		FPaths::ProjectSavedDir(), TEXT("TerrainPainter"),
+		FString::Printf(TEXT("%s_%08x.r16"), *FPaths::GetBaseFilename(PngPath), GetTypeHash(FPaths::ConvertRelativePathToFull(PngPath)))
+	);
+
+	IFileManager& fileManager{ IFileManager::Get() };
+	const TUniquePtr<FArchive> reader{ fileManager.CreateFileReader(*PngPath) };
+	FPngHeader header;
+	if (!reader || !header.Read(*reader))
+	{
+		OutError = FString::Printf(TEXT("Failed to read PNG heightmap '%s'."), *PngPath);
+		return false;
+	}
+	OutResolution = header.Resolution;
+
+	// Only the header is read when the cache is up to date
+	if (fileManager.FileExists(*OutRawPath) && fileManager.GetTimeStamp(*OutRawPath) >= fileManager.GetTimeStamp(*PngPath))
+	{
+		return true;
+	}
+
+	const int32 numChannels{ header.GetNumChannels() };
+	if (numChannels == 0 || (header.BitDepth != 8 && header.BitDepth != 16) || header.Interlace != 0)
+	{
+		OutError = FString::Printf(TEXT("PNG heightmap '%s' must be non-interlaced, with 8 or 16 bits per sample."), *PngPath);
+		return false;
+	}
+
+	// Written aside and moved in place once complete, so a failed decode never leaves a cache that looks up to date
+	const FString tempPath{ OutRawPath + TEXT(".tmp") };
+	TUniquePtr<FArchive> writer{ fileManager.CreateFileWriter(*tempPath) };
+	if (!writer)
+	{
+		OutError = FString::Printf(TEXT("Failed to write heightmap cache '%s'."), *OutRawPath);
+		return false;
+	}
+
+	// Only two rows are ever decoded at a time; the first sample of each pixel (gray or red) is the height
+	const int32 bytesPerPixel{ numChannels * header.BitDepth / 8 };
+	const int32 rowSize{ 1 + header.Resolution.X * bytesPerPixel };
+	TArray<uint8> row;
+	TArray<uint8> previous;
+	row.SetNumUninitialized(rowSize);
+	previous.SetNumZeroed(rowSize);
+	TArray<uint16> heights;
+	heights.SetNumUninitialized(header.Resolution.X);
+	TArray<uint8> input;
+	input.SetNumUninitialized(64 * 1024);
+
+	z_stream stream{};
+	inflateInit(&stream);
+	int32 numRows{};
+	int32 rowFill{};
+	bool isValid{ true };
+	bool isStreamDone{};
+	while (isValid && !isStreamDone)
+	{
+		uint8 chunkHeader[8];
+		reader->Serialize(chunkHeader, 8);
+		if (reader->IsError())
+		{
+			isValid = false;
+			break;
+		}
+		const int64 chunkSize{ ReadBigEndian32(chunkHeader) };
+		if (FMemory::Memcmp(chunkHeader + 4, "IEND", 4) == 0) break;
+		if (FMemory::Memcmp(chunkHeader + 4, "IDAT", 4) != 0)
+		{
+			reader->Seek(reader->Tell() + chunkSize + 4);
+			continue;
+		}
+
+		for (int64 remaining{ chunkSize }; isValid && !isStreamDone && remaining > 0;)
+		{
+			const int32 numRead{ static_cast<int32>(FMath::Min<int64>(remaining, input.Num())) };
+			reader->Serialize(input.GetData(), numRead);
+			remaining -= numRead;
+			isValid = !reader->IsError();
+
+			stream.next_in = input.GetData();
+			stream.avail_in = numRead;
+			while (isValid && !isStreamDone && stream.avail_in > 0)
+			{
+				stream.next_out = row.GetData() + rowFill;
+				stream.avail_out = rowSize - rowFill;
+				const int32 result{ inflate(&stream, Z_NO_FLUSH) };
+				isStreamDone = result == Z_STREAM_END;
+				isValid = result == Z_OK || isStreamDone;
+				rowFill = rowSize - stream.avail_out;
+				if (!isValid || rowFill < rowSize) continue;
+
+				if (numRows == header.Resolution.Y || !Unfilter(row, previous, bytesPerPixel))
+				{
+					isValid = false;
+					break;
+				}
+				for (int32 x{}; x < header.Resolution.X; ++x)
+				{
+					const uint8* sample{ row.GetData() + 1 + x * bytesPerPixel };
+					heights[x] = header.BitDepth == 16 ? static_cast<uint16>(sample[0] << 8 | sample[1]) : static_cast<uint16>(sample[0] * 257);
+				}
+				writer->Serialize(heights.GetData(), heights.Num() * sizeof(uint16));
+				Swap(row, previous);
+				rowFill = 0;
+				++numRows;
+			}
+		}
+		// CRC
+		reader->Seek(reader->Tell() + 4);
+	}
+	inflateEnd(&stream);
+
+	isValid = isValid && isStreamDone && numRows == header.Resolution.Y && rowFill == 0;
+	const bool isWritten{ writer->Close() && !writer->IsError() };
+	writer.Reset();
+	if (!isValid || !isWritten)
+	{
+		fileManager.Delete(*tempPath);
+		OutError = isValid
+			? FString::Printf(TEXT("Failed to write heightmap cache '%s'."), *OutRawPath)
+			: FString::Printf(TEXT("Failed to decode PNG heightmap '%s'."), *PngPath);
+		return false;
+	}
+
+	if (!fileManager.Move(*OutRawPath, *tempPath))
+	{
+		fileManager.Delete(*tempPath);
+		OutError = FString::Printf(TEXT("Failed to write heightmap cache '%s'."), *OutRawPath);
+		return false;
+	}
+	return true;
+}
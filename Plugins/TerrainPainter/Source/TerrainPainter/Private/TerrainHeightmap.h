@@ -0,0 +1,65 @@
+#pragma once
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+/**
+ * A horizontal strip of heightmap rows, sampled by the rasterizer for one band.
+ * Only a view into the heightmap's mapping; only valid while the heightmap is.
+ */
+class FTerrainHeightmapTile
+{
+public:
+	FTerrainHeightmapTile(const uint16* heights, FIntPoint resolution, int32 firstRow, int32 numRows, FVector worldSize);
+
+	/** Bilinear height at UV, normalized to [0, 1] */
+	float SampleHeight(FVector2f UV) const;
+
+	/** Terrain slope at UV in degrees, from central differences in world units */
+	float SampleSlope(FVector2f UV) const;
+
+private:
+	// Row FirstRow of the heightmap
+	const uint16* Heights{};
+	FIntPoint Resolution{};
+	int32 FirstRow{};
+	int32 NumRows{};
+	FVector WorldSize{};
+
+	float GetHeight(int32 X, int32 Y) const;
+};
+
+/**
+ * 16-bit heightmap that is never fully resident: the file is memory mapped once, and only the pages under the
+ * rows bands sample through their FTerrainHeightmapTiles are ever read in.
+ * RAW/R16 files are mapped directly; PNGs get decoded once, row by row, into a RAW cache under Saved/ which is then mapped.
+ * Tiles may be taken & sampled from any thread.
+ */
+class FTerrainHeightmap
+{
+public:
+	~FTerrainHeightmap();
+
+	/**
+	 * Opens the heightmap at FilePath.
+	 * @param RawResolution Resolution of headerless RAW files; if zero, the file is assumed to be square
+	 * @param worldSize Size of the terrain in world units, Z being the full height range; used for slopes
+	 */
+	static TSharedPtr<FTerrainHeightmap> Open(const FString& FilePath, FIntPoint RawResolution, FVector worldSize, FString& OutError);
+
+	/** The heightmap rows needed to sample output rows [RowBegin, RowEnd) of an image OutputHeight tall */
+	FTerrainHeightmapTile GetTile(int32 OutputHeight, int32 RowBegin, int32 RowEnd) const;
+
+	FIntPoint GetResolution() const { return Resolution; }
+
+private:
+	FTerrainHeightmap() = default;
+
+	static bool TryConvertPngToRaw(const FString& PngPath, FString& OutRawPath, FIntPoint& OutResolution, FString& OutError);
+
+	// The region covers the whole file; declared after the handle, so it's unmapped first
+	TUniquePtr<IMappedFileHandle> Handle;
+	TUniquePtr<IMappedFileRegion> Region;
+	FIntPoint Resolution{};
+	FVector WorldSize{};
+};
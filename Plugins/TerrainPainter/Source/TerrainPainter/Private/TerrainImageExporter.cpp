@@ -0,0 +1,496 @@
+#include "TerrainImageExporter.h"
+
+#include "TerrainColorRasterizer.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "Serialization/MemoryWriter.h"
+
+THIRD_PARTY_INCLUDES_START
+#include "zlib.h"
+THIRD_PARTY_INCLUDES_END
+
+namespace
+{
+	void WriteBigEndian32(FArchive& Ar, uint32 Value)
+	{
+		uint8 bytes[4]{ static_cast<uint8>(Value >> 24), static_cast<uint8>(Value >> 16), static_cast<uint8>(Value >> 8), static_cast<uint8>(Value) };
+		Ar.Serialize(bytes, 4);
+	}
+
+	void WritePngChunk(FArchive& Ar, const char* Type, uint8* Data, uint32 Size)
+	{
+		WriteBigEndian32(Ar, Size);
+
+		uint8 type[4]{ static_cast<uint8>(Type[0]), static_cast<uint8>(Type[1]), static_cast<uint8>(Type[2]), static_cast<uint8>(Type[3]) };
+		Ar.Serialize(type, 4);
+		if (Size > 0) Ar.Serialize(Data, Size);
+
+		uLong crc{ crc32(0, type, 4) };
+		if (Size > 0) crc = crc32(crc, Data, Size);
+		WriteBigEndian32(Ar, static_cast<uint32>(crc));
+	}
+
+	uint8 ToByte(float Value)
+	{
+		return static_cast<uint8>(FMath::RoundToInt32(FMath::Clamp(Value, 0.f, 1.f) * 255.f));
+	}
+
+	/** 8-bit RGB PNG; rows are Sub-filtered and deflated as they come in, IDAT chunks are flushed whenever the output buffer fills */
+	class FPngImageWriter final : public FTerrainImageWriter
+	{
+	public:
+		virtual void Begin(FArchive& Ar, FIntPoint Size) override
+		{
+			Width = Size.X;
+
+			uint8 signature[8]{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+			Ar.Serialize(signature, 8);
+
+			uint8 header[13]{
+				static_cast<uint8>(Size.X >> 24), static_cast<uint8>(Size.X >> 16), static_cast<uint8>(Size.X >> 8), static_cast<uint8>(Size.X),
+				static_cast<uint8>(Size.Y >> 24), static_cast<uint8>(Size.Y >> 16), static_cast<uint8>(Size.Y >> 8), static_cast<uint8>(Size.Y),
+				// 8 bit, truecolor, deflate, adaptive filtering, no interlace
+				8, 2, 0, 0, 0
+			};
+			WritePngChunk(Ar, "IHDR", header, sizeof(header));
+
+			deflateInit(&Stream, Z_DEFAULT_COMPRESSION);
+			Output.SetNumUninitialized(ChunkCapacity);
+			Stream.next_out = Output.GetData();
+			Stream.avail_out = ChunkCapacity;
+
+			FilteredRow.SetNumUninitialized(1 + Width * 3);
+		}
+
+		virtual void WriteRows(FArchive& Ar, TArrayView<const FLinearColor> Rows) override
+		{
+			for (int32 rowStart{}; rowStart < Rows.Num(); rowStart += Width)
+			{
+				// Sub filter: each byte stores the difference to the same channel of the pixel to its left
+				uint8* out{ FilteredRow.GetData() };
+				*out++ = 1;
+				uint8 previous[3]{};
+				for (int32 x{}; x < Width; ++x)
+				{
+					const FLinearColor& color{ Rows[rowStart + x] };
+					const uint8 rgb[3]{ ToByte(color.R), ToByte(color.G), ToByte(color.B) };
+					for (int32 c{}; c < 3; ++c)
+					{
+						*out++ = static_cast<uint8>(rgb[c] - previous[c]);
+						previous[c] = rgb[c];
+					}
+				}
+
+				Deflate(Ar, FilteredRow.GetData(), FilteredRow.Num(), Z_NO_FLUSH);
+			}
+		}
+
+		virtual void End(FArchive& Ar) override
+		{
+			Deflate(Ar, nullptr, 0, Z_FINISH);
+			deflateEnd(&Stream);
+			WritePngChunk(Ar, "IEND", nullptr, 0);
+		}
+
+	private:
+		static constexpr uint32 ChunkCapacity{ 256 * 1024 };
+
+		z_stream Stream{};
+		TArray<uint8> Output;
+		TArray<uint8> FilteredRow;
+		int32 Width{};
+
+		void Deflate(FArchive& Ar, uint8* Data, uint32 Size, int32 Flush)
+		{
+			Stream.next_in = Data;
+			Stream.avail_in = Size;
+
+			int32 result{ Z_OK };
+			do
+			{
+				result = deflate(&Stream, Flush);
+				const bool isFull{ Stream.avail_out == 0 };
+				const bool isDone{ Flush == Z_FINISH && result == Z_STREAM_END };
+				if (isFull || isDone)
+				{
+					WritePngChunk(Ar, "IDAT", Output.GetData(), ChunkCapacity - Stream.avail_out);
+					Stream.next_out = Output.GetData();
+					Stream.avail_out = ChunkCapacity;
+				}
+			}
+			while (Stream.avail_in > 0 || (Flush == Z_FINISH && result != Z_STREAM_END));
+		}
+	};
+
+	/**
+	 * Uncompressed scanline OpenEXR with B, G, R channels.
+	 * Without compression every scanline block has the same size, so the offset table can be written up front.
+	 */
+	class FExrImageWriter final : public FTerrainImageWriter
+	{
+	public:
+		explicit FExrImageWriter(bool fullFloat)
+			: FullFloat{ fullFloat }
+		{
+		}
+
+		virtual void Begin(FArchive& Ar, FIntPoint Size) override
+		{
+			Width = Size.X;
+			NextRow = 0;
+
+			int32 magic{ 20000630 };
+			int32 version{ 2 };
+			Ar << magic << version;
+
+			// Channel list; channels must be sorted by name
+			{
+				TArray<uint8> channels;
+				for (const char* name : { "B", "G", "R" })
+				{
+					channels.Add(static_cast<uint8>(name[0]));
+					channels.Add(0);
+					AppendInt32(channels, FullFloat ? 2 : 1);
+					// pLinear & reserved
+					channels.AddZeroed(4);
+					// x & y sampling
+					AppendInt32(channels, 1);
+					AppendInt32(channels, 1);
+				}
+				channels.Add(0);
+				WriteAttribute(Ar, "channels", "chlist", channels);
+			}
+
+			WriteAttribute(Ar, "compression", "compression", { 0 });
+
+			TArray<uint8> window;
+			AppendInt32(window, 0);
+			AppendInt32(window, 0);
+			AppendInt32(window, Size.X - 1);
+			AppendInt32(window, Size.Y - 1);
+			WriteAttribute(Ar, "dataWindow", "box2i", window);
+			WriteAttribute(Ar, "displayWindow", "box2i", window);
+
+			WriteAttribute(Ar, "lineOrder", "lineOrder", { 0 });
+
+			TArray<uint8> one;
+			AppendFloat(one, 1.f);
+			WriteAttribute(Ar, "pixelAspectRatio", "float", one);
+			WriteAttribute(Ar, "screenWindowWidth", "float", one);
+
+			TArray<uint8> center;
+			AppendFloat(center, 0.f);
+			AppendFloat(center, 0.f);
+			WriteAttribute(Ar, "screenWindowCenter", "v2f", center);
+
+			uint8 headerEnd{ 0 };
+			Ar << headerEnd;
+
+			// Offset table
+			const int32 bytesPerSample{ FullFloat ? 4 : 2 };
+			RowData.SetNumUninitialized(Width * 3 * bytesPerSample);
+			const uint64 blockSize{ 8 + static_cast<uint64>(RowData.Num()) };
+			uint64 offset{ static_cast<uint64>(Ar.Tell()) + static_cast<uint64>(Size.Y) * sizeof(uint64) };
+			for (int32 y{}; y < Size.Y; ++y)
+			{
+				Ar << offset;
+				offset += blockSize;
+			}
+		}
+
+		virtual void WriteRows(FArchive& Ar, TArrayView<const FLinearColor> Rows) override
+		{
+			for (int32 rowStart{}; rowStart < Rows.Num(); rowStart += Width)
+			{
+				const TArrayView<const FLinearColor> row{ Rows.Slice(rowStart, Width) };
+				if (FullFloat)
+				{
+					float* out{ reinterpret_cast<float*>(RowData.GetData()) };
+					for (int32 x{}; x < Width; ++x) out[x] = row[x].B;
+					for (int32 x{}; x < Width; ++x) out[Width + x] = row[x].G;
+					for (int32 x{}; x < Width; ++x) out[2 * Width + x] = row[x].R;
+				}
+				else
+				{
+					FFloat16* out{ reinterpret_cast<FFloat16*>(RowData.GetData()) };
+					for (int32 x{}; x < Width; ++x) out[x] = FFloat16(row[x].B);
+					for (int32 x{}; x < Width; ++x) out[Width + x] = FFloat16(row[x].G);
+					for (int32 x{}; x < Width; ++x) out[2 * Width + x] = FFloat16(row[x].R);
+				}
+
+				int32 y{ NextRow++ };
+				int32 dataSize{ RowData.Num() };
+				Ar << y << dataSize;
+				Ar.Serialize(RowData.GetData(), RowData.Num());
+			}
+		}
+
+		virtual void End(FArchive& Ar) override
+		{
+		}
+
+	private:
+		bool FullFloat{};
+		int32 Width{};
+		int32 NextRow{};
+		TArray<uint8> RowData;
+
+		static void AppendInt32(TArray<uint8>& Bytes, int32 Value)
+		{
+			Bytes.Append(reinterpret_cast<const uint8*>(&Value), sizeof(Value));
+		}
+
+		static void AppendFloat(TArray<uint8>& Bytes, float Value)
+		{
+			Bytes.Append(reinterpret_cast<const uint8*>(&Value), sizeof(Value));
+		}
+
+		static void WriteAttribute(FArchive& Ar, const char* Name, const char* Type, TArray<uint8> Value)
+		{
+			Ar.Serialize(const_cast<char*>(Name), FCStringAnsi::Strlen(Name) + 1);
+			Ar.Serialize(const_cast<char*>(Type), FCStringAnsi::Strlen(Type) + 1);
+			int32 size{ Value.Num() };
+			Ar << size;
+			Ar.Serialize(Value.GetData(), Value.Num());
+		}
+	};
+
+	class FRaw16ImageWriter final : public FTerrainImageWriter
+	{
+	public:
+		virtual void Begin(FArchive& Ar, FIntPoint Size) override
+		{
+		}
+
+		virtual void WriteRows(FArchive& Ar, TArrayView<const FLinearColor> Rows) override
+		{
+			Data.SetNumUninitialized(Rows.Num() * 4, EAllowShrinking::No);
+			for (int32 i{}; i < Rows.Num(); ++i)
+			{
+				const FLinearColor& color{ Rows[i] };
+				Data[i * 4 + 0] = ToWord(color.R);
+				Data[i * 4 + 1] = ToWord(color.G);
+				Data[i * 4 + 2] = ToWord(color.B);
+				Data[i * 4 + 3] = ToWord(color.A);
+			}
+			Ar.Serialize(Data.GetData(), Data.Num() * sizeof(uint16));
+		}
+
+		virtual void End(FArchive& Ar) override
+		{
+		}
+
+	private:
+		TArray<uint16> Data;
+
+		static uint16 ToWord(float Value)
+		{
+			return static_cast<uint16>(FMath::RoundToInt32(FMath::Clamp(Value, 0.f, 1.f) * 65535.f));
+		}
+	};
+}
+
+TUniquePtr<FTerrainImageWriter> FTerrainImageWriter::Create(ETerrainExportFormat Format)
+{
+	switch (Format)
+	{
+	case ETerrainExportFormat::PNG:
+		return MakeUnique<FPngImageWriter>();
+	case ETerrainExportFormat::EXRHalf:
+		return MakeUnique<FExrImageWriter>(false);
+	case ETerrainExportFormat::EXRFloat:
+		return MakeUnique<FExrImageWriter>(true);
+	case ETerrainExportFormat::RAW16:
+		return MakeUnique<FRaw16ImageWriter>();
+	}
+	return nullptr;
+}
+
+const TCHAR* FTerrainImageWriter::GetExtension(ETerrainExportFormat Format)
+{
+	switch (Format)
+	{
+	case ETerrainExportFormat::PNG:
+		return TEXT("png");
+	case ETerrainExportFormat::EXRHalf:
+	case ETerrainExportFormat::EXRFloat:
+		return TEXT("exr");
+	case ETerrainExportFormat::RAW16:
+		return TEXT("raw");
+	}
+	return TEXT("");
+}
+
+bool FTerrainImageExporter::Export(
+	const FTerrainColorRasterizer& Rasterizer, FIntPoint Size, ETerrainExportFormat Format, const FString& FilePath,
+	FString& OutError, TFunctionRef<void(float)> OnProgress)
+{
+	const TUniquePtr<FArchive> file{ IFileManager::Get().CreateFileWriter(*FilePath) };
+	if (!file)
+	{
+		OutError = FString::Printf(TEXT("Failed to open '%s' for writing."), *FilePath);
+		return false;
+	}
+
+	const TUniquePtr<FTerrainImageWriter> writer{ FTerrainImageWriter::Create(Format) };
+	check(writer);
+	writer->Begin(*file, Size);
+
+	const int32 bandsPerWave{ FMath::Clamp(FTaskGraphInterface::Get().GetNumWorkerThreads(), 1, MaxBandsPerWave) };
+	const int32 rowsPerWave{ bandsPerWave * BandHeight };
+
+	// Double buffered: one wave is written while the next is computed
+	TArray<FLinearColor> waves[2];
+	waves[0].SetNumUninitialized(rowsPerWave * Size.X);
+	waves[1].SetNumUninitialized(rowsPerWave * Size.X);
+	TFuture<void> pendingWrite;
+
+	int32 waveIndex{};
+	for (int32 waveBegin{}; waveBegin < Size.Y; waveBegin += rowsPerWave, ++waveIndex)
+	{
+		const int32 waveEnd{ FMath::Min(waveBegin + rowsPerWave, Size.Y) };
+		TArray<FLinearColor>& wave{ waves[waveIndex % 2] };
+
+		const int32 numBands{ FMath::DivideAndRoundUp(waveEnd - waveBegin, BandHeight) };
+		ParallelFor(numBands, [&Rasterizer, &wave, Size, waveBegin, waveEnd](int32 band)
+		{
+			const int32 rowBegin{ waveBegin + band * BandHeight };
+			const int32 rowEnd{ FMath::Min(rowBegin + BandHeight, waveEnd) };
+			const TArrayView<FLinearColor> rows{ MakeArrayView(wave).Slice((rowBegin - waveBegin) * Size.X, (rowEnd - rowBegin) * Size.X) };
+			Rasterizer.RasterizeBand(Size, rowBegin, rowEnd, rows);
+		});
+
+		// The previous wave has to be on disk before this one may be written (and before its buffer gets reused)
+		if (pendingWrite.IsValid()) pendingWrite.Wait();
+
+		const TArrayView<const FLinearColor> waveRows{ MakeArrayView(wave).Slice(0, (waveEnd - waveBegin) * Size.X) };
+		pendingWrite = Async(EAsyncExecution::ThreadPool, [&writer, &file, waveRows]()
+		{
+			writer->WriteRows(*file, waveRows);
+		});
+
+		OnProgress(static_cast<float>(waveEnd) / Size.Y);
+	}
+
+	if (pendingWrite.IsValid()) pendingWrite.Wait();
+	writer->End(*file);
+
+	if (!file->Close())
+	{
+		OutError = FString::Printf(TEXT("Failed to write '%s'."), *FilePath);
+		return false;
+	}
+	return true;
+}
+
+bool FTerrainImageExporter::EncodePNG(FIntPoint Size, TArrayView<const FColor> Pixels, TArray64<uint8>& OutData)
+{
+	check(Pixels.Num() == Size.X * Size.Y);
+
+	const int64 rowBytes{ 1 + static_cast<int64>(Size.X) * 4 };
+	const int32 numBlocks{ FMath::DivideAndRoundUp(Size.Y, PngBlockRows) };
+
+	struct FBlock
+	{
+		TArray64<uint8> Chunk;
+		uLong Adler{};
+		int64 FilteredSize{};
+		bool IsDeflated{};
+	};
+	TArray<FBlock> blocks;
+	blocks.SetNum(numBlocks);
+
+	ParallelFor(numBlocks, [Size, Pixels, rowBytes, numBlocks, &blocks](int32 index)
+	{
+		const int32 rowBegin{ index * PngBlockRows };
+		const int32 rowEnd{ FMath::Min(rowBegin + PngBlockRows, Size.Y) };
+		FBlock& block{ blocks[index] };
+
+		// Sub filter, RGBA byte order
+		TArray64<uint8> filtered;
+		filtered.SetNumUninitialized((rowEnd - rowBegin) * rowBytes);
+		uint8* out{ filtered.GetData() };
+		for (int32 y{ rowBegin }; y < rowEnd; ++y)
+		{
+			*out++ = 1;
+			uint8 previous[4]{};
+			for (int32 x{}; x < Size.X; ++x)
+			{
+				const FColor& color{ Pixels[y * Size.X + x] };
+				const uint8 rgba[4]{ color.R, color.G, color.B, color.A };
+				for (int32 c{}; c < 4; ++c)
+				{
+					*out++ = static_cast<uint8>(rgba[c] - previous[c]);
+					previous[c] = rgba[c];
+				}
+			}
+		}
+		block.FilteredSize = filtered.Num();
+		block.Adler = adler32(1, filtered.GetData(), filtered.Num());
+
+		// Raw deflate; all but the last block end on a sync flush, so they join into one stream
+		z_stream stream{};
+		if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) return;
+		const bool isLast{ index == numBlocks - 1 };
+
+		// Room for the chunk's length & type up front, its CRC is appended once the data is known
+		block.Chunk.SetNumUninitialized(8 + deflateBound(&stream, filtered.Num()) + 16);
+		stream.next_in = filtered.GetData();
+		stream.avail_in = filtered.Num();
+		stream.next_out = block.Chunk.GetData() + 8;
+		stream.avail_out = block.Chunk.Num() - 8;
+		const int32 result{ deflate(&stream, isLast ? Z_FINISH : Z_SYNC_FLUSH) };
+		const uint32 dataSize{ static_cast<uint32>(stream.total_out) };
+		// All input has to be in, and a sync flush is only complete if it didn't run out of room
+		block.IsDeflated = stream.avail_in == 0 && (isLast ? result == Z_STREAM_END : result == Z_OK && stream.avail_out > 0);
+		deflateEnd(&stream);
+		if (!block.IsDeflated) return;
+
+		uint8* chunk{ block.Chunk.GetData() };
+		chunk[0] = static_cast<uint8>(dataSize >> 24);
+		chunk[1] = static_cast<uint8>(dataSize >> 16);
+		chunk[2] = static_cast<uint8>(dataSize >> 8);
+		chunk[3] = static_cast<uint8>(dataSize);
+		FMemory::Memcpy(chunk + 4, "IDAT", 4);
+		const uLong crc{ crc32(0, chunk + 4, 4 + dataSize) };
+		block.Chunk.SetNum(8 + dataSize + 4);
+		chunk = block.Chunk.GetData();
+		chunk[8 + dataSize] = static_cast<uint8>(crc >> 24);
+		chunk[9 + dataSize] = static_cast<uint8>(crc >> 16);
+		chunk[10 + dataSize] = static_cast<uint8>(crc >> 8);
+		chunk[11 + dataSize] = static_cast<uint8>(crc);
+	});
+
+	OutData.Reset();
+	if (blocks.ContainsByPredicate([](const FBlock& block){ return !block.IsDeflated; })) return false;
+
+	FMemoryWriter64 writer{ OutData };
+
+	uint8 signature[8]{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	writer.Serialize(signature, 8);
+
+	uint8 header[13]{
+		static_cast<uint8>(Size.X >> 24), static_cast<uint8>(Size.X >> 16), static_cast<uint8>(Size.X >> 8), static_cast<uint8>(Size.X),
+		static_cast<uint8>(Size.Y >> 24), static_cast<uint8>(Size.Y >> 16), static_cast<uint8>(Size.Y >> 8), static_cast<uint8>(Size.Y),
+		// 8 bit, truecolor with alpha, deflate, adaptive filtering, no interlace
+		8, 6, 0, 0, 0
+	};
+	WritePngChunk(writer, "IHDR", header, sizeof(header));
+
+	// The zlib header & trailer get chunks of their own around the blocks
+	uint8 zlibHeader[2]{ 0x78, 0x9C };
+	WritePngChunk(writer, "IDAT", zlibHeader, 2);
+
+	uLong adler{ 1 };
+	for (FBlock& block : blocks)
+	{
+		writer.Serialize(block.Chunk.GetData(), block.Chunk.Num());
+		adler = adler32_combine(adler, block.Adler, block.FilteredSize);
+	}
+
+	uint8 zlibTrailer[4]{ static_cast<uint8>(adler >> 24), static_cast<uint8>(adler >> 16), static_cast<uint8>(adler >> 8), static_cast<uint8>(adler) };
+	WritePngChunk(writer, "IDAT", zlibTrailer, 4);
+	WritePngChunk(writer, "IEND", nullptr, 0);
+	return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "TerrainImageExporter.generated.h"
+
+class FTerrainColorRasterizer;
+
+UENUM(BlueprintType)
+enum class ETerrainExportFormat : uint8
+{
+	PNG,
+	EXRHalf,
+	EXRFloat,
+	// Headerless 16-bit little endian RGBA
+	RAW16
+};
+
+/** Receives an image row band by row band, strictly top to bottom, and streams it to disk */
+class FTerrainImageWriter
+{
+public:
+	virtual ~FTerrainImageWriter() = default;
+
+	virtual void Begin(FArchive& Ar, FIntPoint Size) = 0;
+	virtual void WriteRows(FArchive& Ar, TArrayView<const FLinearColor> Rows) = 0;
+	virtual void End(FArchive& Ar) = 0;
+
+	static TUniquePtr<FTerrainImageWriter> Create(ETerrainExportFormat Format);
+	static const TCHAR* GetExtension(ETerrainExportFormat Format);
+};
+
+/**
+ * Exports the color map straight to an image file without ever holding the full image.
+ * Rows are rasterized a wave of bands at a time; while one wave is written to disk on a worker
+ * the next one is being computed, so only two waves are ever resident.
+ */
+class FTerrainImageExporter
+{
+public:
+	static bool Export(
+		const FTerrainColorRasterizer& Rasterizer, FIntPoint Size, ETerrainExportFormat Format, const FString& FilePath,
+		FString& OutError, TFunctionRef<void(float /*Progress*/)> OnProgress);
+
+	/**
+	 * Encodes Pixels as an 8-bit RGBA PNG in memory, deflating blocks of rows in parallel.
+	 * Each block is a byte-aligned piece of one deflate stream and its own IDAT chunk; their checksums are combined at the end.
+	 * @return false if deflating any block failed, leaving OutData empty
+	 */
+	static bool EncodePNG(FIntPoint Size, TArrayView<const FColor> Pixels, TArray64<uint8>& OutData);
+
+	/** Rows per band; kept small since a single band of a 16K export is already Size.X * 16 bytes per row */
+	static constexpr int32 BandHeight{ 8 };
+
+	/** Upper bound of bands computed in parallel per wave */
+	static constexpr int32 MaxBandsPerWave{ 16 };
+
+	/** Rows deflated together per parallel PNG block */
+	static constexpr int32 PngBlockRows{ 64 };
+};
@@ -4,18 +4,29 @@
 
 #include "EditorUtilitySubsystem.h"
 #include "EditorUtilityWidgetBlueprint.h"
+#include "Misc/CoreDelegates.h"
+#include "UObject/UObjectGlobals.h"
 
 #define LOCTEXT_NAMESPACE "FTerrainPainterModule"
 
+namespace
+{
+	const TCHAR* WidgetPackagePath{ TEXT("/TerrainPainter/Widgets/EUW_TerrainPainterWidget") };
+	const TCHAR* WidgetClassPath{ TEXT("/TerrainPainter/Widgets/EUW_TerrainPainterWidget.EUW_TerrainPainterWidget") };
+}
+
 void FTerrainPainterModule::StartupModule()
 {
 	UToolMenus::RegisterStartupCallback(FSimpleMulticastDelegate::FDelegate::CreateRaw(this, &FTerrainPainterModule::RegisterMenus));
+	PostEngineInitHandle = FCoreDelegates::OnPostEngineInit.AddRaw(this, &FTerrainPainterModule::PreloadWidgetBlueprint);
 }
 
 void FTerrainPainterModule::ShutdownModule()
 {
 	UToolMenus::UnregisterOwner(FToolMenuOwner(this));
 	UToolMenus::UnRegisterStartupCallback(this);
+	FCoreDelegates::OnPostEngineInit.Remove(PostEngineInitHandle);
+	WidgetBlueprint.Reset();
 }
 
 void FTerrainPainterModule::RegisterMenus()
@@ -46,14 +57,27 @@ void FTerrainPainterModule::OpenTerrainPainterWidget()
 	UEditorUtilitySubsystem* editorUtility{ GEditor->GetEditorSubsystem<UEditorUtilitySubsystem>() };
 	checkf(editorUtility, TEXT("Editor utility subsystem couldn't be loaded."));
 
-	const FString widgetClassPath{ TEXT("/TerrainPainter/Widgets/EUW_TerrainPainterWidget.EUW_TerrainPainterWidget") };
-	
-	UEditorUtilityWidgetBlueprint* widgetClass{ LoadObject<UEditorUtilityWidgetBlueprint>(nullptr, *widgetClassPath) };
-	if (!ensureAlwaysMsgf(widgetClass,
+	// Normally preloaded by now; only load synchronously if the tab is opened before that finished
+	if (!WidgetBlueprint)
+	{
+		WidgetBlueprint.Reset(LoadObject<UEditorUtilityWidgetBlueprint>(nullptr, WidgetClassPath));
+	}
+	if (!ensureAlwaysMsgf(WidgetBlueprint,
 		TEXT("Couldn't find Terrain Painter Widget class! Make sure the package is located at the correct path.")
 		)) return;
 	
-	editorUtility->SpawnAndRegisterTab(widgetClass);
+	editorUtility->SpawnAndRegisterTab(WidgetBlueprint.Get());
+}
+
+void FTerrainPainterModule::PreloadWidgetBlueprint()
+{
+	LoadPackageAsync(WidgetPackagePath, FLoadPackageAsyncDelegate::CreateLambda(
+		[this](const FName& PackageName, UPackage* LoadedPackage, EAsyncLoadingResult::Type Result)
+		{
+			if (Result != EAsyncLoadingResult::Succeeded || WidgetBlueprint) return;
+			WidgetBlueprint.Reset(FindObject<UEditorUtilityWidgetBlueprint>(nullptr, WidgetClassPath));
+		}
+	));
 }
 
 #undef LOCTEXT_NAMESPACE
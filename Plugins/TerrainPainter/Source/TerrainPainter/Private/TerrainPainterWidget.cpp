@@ -9,9 +9,22 @@
 #include "UObject/SavePackage.h"
 #include "Widgets/Notifications/SNotificationList.h"
 #include "PropertyViewHelpers.h"
+#include "Algo/Count.h"
 #include "Algo/RandomShuffle.h"
 #include "Components/SizeBox.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Blueprint/WidgetTree.h"
+#include "Components/UniformGridPanel.h"
 #include "Engine/Canvas.h"
+#include "HAL/FileManager.h"
+#include "ImageCore.h"
+#include "ImageUtils.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopedSlowTask.h"
+#include "TerrainColorRasterizer.h"
+#include "TerrainGraphImporter.h"
+#include "TerrainHeightmap.h"
 
 const TMap<ETerrainColorPreset, TArray<FLinearColor>> UTerrainPainterWidget::TerrainColorPresets =
 {
@@ -79,36 +92,44 @@ void UTerrainPainterWidget::NativePreConstruct()
 		GET_MEMBER_NAME_CHECKED(ThisClass, TerrainColorOutputDirectory),
 		GET_MEMBER_NAME_CHECKED(ThisClass, TerrainColorOutputAssetName),
 		GET_MEMBER_NAME_CHECKED(ThisClass, TextureSize),
+		GET_MEMBER_NAME_CHECKED(ThisClass, BakeSplatMaps),
+		GET_MEMBER_NAME_CHECKED(ThisClass, BakeTiers),
+		GET_MEMBER_NAME_CHECKED(ThisClass, TierSource),
 		
-		GET_MEMBER_NAME_CHECKED(ThisClass, GenerationData),
+		GET_MEMBER_NAME_CHECKED(ThisClass, GraphAsset),
+		GET_MEMBER_NAME_CHECKED(ThisClass, FalloffKernel),
+		GET_MEMBER_NAME_CHECKED(ThisClass, TerrainColorPreset),
+		GET_MEMBER_NAME_CHECKED(ThisClass, GraphColoringAlgorithm),
+		GET_MEMBER_NAME_CHECKED(ThisClass, ColoringTimeLimit),
+
+		GET_MEMBER_NAME_CHECKED(ThisClass, HeightmapFile),
+		GET_MEMBER_NAME_CHECKED(ThisClass, HeightmapResolution),
+		GET_MEMBER_NAME_CHECKED(ThisClass, HeightmapWorldSize),
+		GET_MEMBER_NAME_CHECKED(ThisClass, HeightMaskBlend),
+
+		GET_MEMBER_NAME_CHECKED(ThisClass, NodeImportFile),
+		GET_MEMBER_NAME_CHECKED(ThisClass, ConnectionImportFile),
+
+		GET_MEMBER_NAME_CHECKED(ThisClass, ExportFile),
+		GET_MEMBER_NAME_CHECKED(ThisClass, ExportFormat),
+		GET_MEMBER_NAME_CHECKED(ThisClass, ExportSize),
+
+		GET_MEMBER_NAME_CHECKED(ThisClass, GallerySource),
+		GET_MEMBER_NAME_CHECKED(ThisClass, GalleryVariants),
+
+		GET_MEMBER_NAME_CHECKED(ThisClass, DebugView),
+		GET_MEMBER_NAME_CHECKED(ThisClass, DebugViewOpacity),
+		GET_MEMBER_NAME_CHECKED(ThisClass, DebugSummary),
 	});
 
 	SetupSinglePropertyView(this, ShowPreviewPV, GET_MEMBER_NAME_CHECKED(ThisClass, ShowPreview));
 	SetupSinglePropertyView(this, GraphModePV, GET_MEMBER_NAME_CHECKED(ThisClass, GraphMode));
 
-	SetupDetailsView(this, GraphDataDetailsView, {}, {
-		GET_MEMBER_NAME_CHECKED(ThisClass, TerrainMapConnections),
-		GET_MEMBER_NAME_CHECKED(ThisClass, TerrainColorPreset),
-		GET_MEMBER_NAME_CHECKED(ThisClass, TerrainColorSet),
-		GET_MEMBER_NAME_CHECKED(ThisClass, GraphColoringAlgorithm),
-	});
-	
-	if (PreviewImage)
-	{
-		PreviewImageTexture = UTexture2D::CreateTransient(TextureSize.X, TextureSize.Y);
-		if (!ensureAlwaysMsgf(PreviewImageTexture, TEXT("Failed to create Preview Image Texture!"))) return;
-
-		// This texture will consistently be the same; the Mip inside will be rebuilt if needed, though
-		PreviewImage->SetBrushFromTexture(PreviewImageTexture, true);
-		UpdatePreviewTexture(true);
-	}
+	BindGraphAsset();
+	ReloadHeightmap();
 
-	if (GraphImage)
-	{
-		// This texture is rebuilt from the CanvasRenderTarget every time
-		UpdateGraphTexture();
-		GraphImage->SetBrushFromTexture(GraphImageTexture, true);
-	}
+	// Nothing gets rendered here; the tab should show up immediately
+	StartDeferredRender();
 }
 
 void UTerrainPainterWidget::NativeConstruct()
@@ -130,23 +151,106 @@ void UTerrainPainterWidget::NativeConstruct()
 	{
 		ApplyGraphColoringButton->OnClicked.AddDynamic(this, &ThisClass::ApplyGraphColoring);
 	}
+
+	if (ImportGraphButton)
+	{
+		ImportGraphButton->OnClicked.AddDynamic(this, &ThisClass::ImportGraph);
+	}
+
+	if (ExportButton)
+	{
+		ExportButton->OnClicked.AddDynamic(this, &ThisClass::ExportImage);
+	}
+
+	if (UndoButton)
+	{
+		UndoButton->OnClicked.AddDynamic(this, &ThisClass::UndoGraphEdit);
+	}
+
+	if (RedoButton)
+	{
+		RedoButton->OnClicked.AddDynamic(this, &ThisClass::RedoGraphEdit);
+	}
+	UpdateHistoryButtons();
+
+	if (GalleryButton)
+	{
+		GalleryButton->OnClicked.AddDynamic(this, &ThisClass::RenderGallery);
+	}
+
+	// Receive undo & redo shortcuts even when nothing inside has focus
+	SetIsFocusable(true);
+}
+
+void UTerrainPainterWidget::NativeDestruct()
+{
+	FTSTicker::GetCoreTicker().RemoveTicker(DeferredRenderTicker);
+	DeferredRenderTicker.Reset();
+	PendingPreview = {};
+
+	FTSTicker::GetCoreTicker().RemoveTicker(InteractionTicker);
+	InteractionTicker.Reset();
+	PendingRegionRender = {};
+	QueuedPreviewRegion = {};
+
+	// The worker colors copies, so it can be left to finish on its own
+	FTSTicker::GetCoreTicker().RemoveTicker(ColoringTicker);
+	ColoringTicker.Reset();
+	PendingColoring = {};
+
+	SaveThumbnail();
+
+	// Nothing baked may get lost with the widget
+	FTSTicker::GetCoreTicker().RemoveTicker(SaveTicker);
+	FlushTextureSaves();
+	UPackage::WaitForAsyncFileWrites();
+
+	Super::NativeDestruct();
+}
+
+FReply UTerrainPainterWidget::NativeOnKeyDown(const FGeometry& InGeometry, const FKeyEvent& InKeyEvent)
+{
+	if (InKeyEvent.GetKey() == EKeys::Delete && GraphAsset->TerrainMapConnections.IsValidIndex(SelectedConnection))
+	{
+		GraphAsset->TerrainMapConnections.RemoveAt(SelectedConnection);
+		SelectedConnection = INDEX_NONE;
+		CommitGraphEdit(TEXT("Delete Connection"), GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, TerrainMapConnections));
+		return FReply::Handled();
+	}
+
+	if (InKeyEvent.IsControlDown())
+	{
+		const bool isUndo{ InKeyEvent.GetKey() == EKeys::Z && !InKeyEvent.IsShiftDown() };
+		const bool isRedo{ InKeyEvent.GetKey() == EKeys::Y || (InKeyEvent.GetKey() == EKeys::Z && InKeyEvent.IsShiftDown()) };
+		if (isUndo || isRedo)
+		{
+			isUndo ? UndoGraphEdit() : RedoGraphEdit();
+			return FReply::Handled();
+		}
+	}
+
+	return Super::NativeOnKeyDown(InGeometry, InKeyEvent);
 }
 
 void UTerrainPainterWidget::OnBakeClicked()
 {
 	const TTuple<bool, FString> state{ TryBakeTexture() };
+	ShowNotification(state.Key, state.Value);
+}
 
+void UTerrainPainterWidget::ShowNotification(bool Success, const FString& Message)
+{
 	// Send slate notification of result
 	FNotificationInfo info(
-		FText::FromString(state.Value)
+		FText::FromString(Message)
 	);
-	info.ExpireDuration = state.Key ? 1.5f : 5.f;
+	info.ExpireDuration = Success ? 1.5f : 5.f;
 	info.bUseSuccessFailIcons = true;
 	
 	const TSharedPtr<SNotificationItem> notif{ FSlateNotificationManager::Get().AddNotification(info) };
 	if (notif.IsValid())
 	{
-		notif->SetCompletionState(state.Key ? SNotificationItem::CS_Success : SNotificationItem::CS_Fail);
+		notif->SetCompletionState(Success ? SNotificationItem::CS_Success : SNotificationItem::CS_Fail);
 	}
 }
 
@@ -160,8 +264,87 @@ TTuple<bool, FString> UTerrainPainterWidget::TryBakeTexture()
 		};
 	}
 
+	// TextureSize plus every tier, all rasterized (or downsampled) in one pass
+	struct FBakeOutput
+	{
+		FString AssetName;
+		FIntPoint Size;
+		TArray<FColor> Color;
+		TArray<FColor> SplatIndices;
+		TArray<FColor> SplatWeights;
+		FTerrainSplatOutput Splat;
+	};
+	TArray<FBakeOutput> outputs;
+	outputs.Add({ TerrainColorOutputAssetName, TextureSize });
+	for (const FTerrainBakeTier& tier : BakeTiers)
+	{
+		outputs.Add({ TerrainColorOutputAssetName + tier.Suffix, tier.Size });
+	}
+
+	TArray<FTerrainBakeTarget> targets;
+	for (FBakeOutput& output : outputs)
+	{
+		const int32 numPixels{ output.Size.X * output.Size.Y };
+		output.Color.SetNumUninitialized(numPixels);
+		if (BakeSplatMaps)
+		{
+			// Color and splat maps come out of the same rasterization pass
+			output.SplatIndices.SetNumUninitialized(numPixels);
+			output.SplatWeights.SetNumUninitialized(numPixels);
+			output.Splat = { output.SplatIndices, output.SplatWeights };
+		}
+		targets.Add({ output.Size, output.Color, BakeSplatMaps ? &output.Splat : nullptr });
+	}
+
+	MakeRasterizer().RasterizeTargets(targets, TierSource == ETerrainTierSource::Downsample);
+
+	// Every image is stored PNG compressed; they're all encoded at once, each one in parallel blocks as well
+	struct FBakeImage
+	{
+		FString AssetName;
+		FIntPoint Size;
+		TArrayView<const FColor> Pixels;
+		bool IsDataTexture{};
+		TArray64<uint8> Png;
+		bool IsEncoded{};
+	};
+	TArray<FBakeImage> images;
+	for (const FBakeOutput& output : outputs)
+	{
+		images.Add({ output.AssetName, output.Size, output.Color, false });
+		if (BakeSplatMaps)
+		{
+			images.Add({ output.AssetName + SplatIndicesSuffix, output.Size, output.SplatIndices, true });
+			images.Add({ output.AssetName + SplatWeightsSuffix, output.Size, output.SplatWeights, true });
+		}
+	}
+	ParallelFor(images.Num(), [&images](int32 i)
+	{
+		images[i].IsEncoded = FTerrainImageExporter::EncodePNG(images[i].Size, images[i].Pixels, images[i].Png);
+	});
+
+	// Nothing gets written unless every image encoded; a truncated PNG would leave the asset with corrupt source
+	for (const FBakeImage& image : images)
+	{
+		if (!image.IsEncoded) return { false, FString::Printf(TEXT("Failed to compress %s."), *image.AssetName) };
+	}
+
+	bool didCreateNew{ false };
+	for (FBakeImage& image : images)
+	{
+		bool didCreateNewImage{ false };
+		const TTuple<bool, FString> state{ TryWriteTextureAsset(image.AssetName, image.Size, image.Png, image.IsDataTexture, didCreateNewImage) };
+		if (!state.Key) return state;
+		if (!image.IsDataTexture) didCreateNew |= didCreateNewImage;
+	}
+
+	return { true, didCreateNew ? TEXT("Successfully created new texture, saving in the background.") : TEXT("Successfully overwrote texture, saving in the background.") };
+}
+
+TTuple<bool, FString> UTerrainPainterWidget::TryWriteTextureAsset(const FString& AssetName, FIntPoint Size, TArrayView64<uint8> PngData, bool IsDataTexture, bool& OutCreatedNew)
+{
 	// Long package name we want to export to, e.g. '/Game/MyFolder/T_MyPackageName'
-	const FString longPackageName{ FPaths::Combine(TerrainColorOutputDirectory.Path, TerrainColorOutputAssetName) };
+	const FString longPackageName{ FPaths::Combine(TerrainColorOutputDirectory.Path, AssetName) };
 
 	// The outer package that will contain the texture assest; creates or finds if it already exists
 	UPackage* package{ CreatePackage(*longPackageName) };
@@ -171,13 +354,13 @@ TTuple<bool, FString> UTerrainPainterWidget::TryBakeTexture()
 	}
 
 	UTexture2D* texture{};
-	bool didCreateNew{ false };
+	OutCreatedNew = false;
 	if (StaticLoadObject(UObject::StaticClass(), nullptr, *longPackageName) == nullptr)
 	{
 		// If the texture asset doesn't exist yet, create a new one
-		texture = NewObject<UTexture2D>(package, *TerrainColorOutputAssetName, RF_Public | RF_Standalone);
+		texture = NewObject<UTexture2D>(package, *AssetName, RF_Public | RF_Standalone);
 		if (!texture) return { false, FString::Printf(TEXT("Failed to create new texture object at %s."), *longPackageName) };
-		didCreateNew = true;
+		OutCreatedNew = true;
 	}
 	else
 	{
@@ -190,20 +373,55 @@ TTuple<bool, FString> UTerrainPainterWidget::TryBakeTexture()
 			texture = Cast<UTexture2D>(object);
 		}
 
-		if (!texture) return { false, "This package already exists and is not a Texture2D." };
+		if (!texture) return { false, FString::Printf(TEXT("Package %s already exists and is not a Texture2D."), *longPackageName) };
 	}
 
 	// Whether newly created or just located, fill the first mip
-	FillTextureWithTerrainColorMap(texture);
+	FillTexture(texture, Size, PngData, IsDataTexture);
 	FAssetRegistryModule::AssetCreated(texture);
-	
-	const FString fileName{ FPackageName::LongPackageNameToFilename(longPackageName, FPackageName::GetAssetPackageExtension()) };
-	if (!UPackage::SavePackage(package, texture, *fileName, {}))
+	package->MarkPackageDirty();
+	QueueTextureSave(texture);
+
+	return { true, {} };
+}
+
+void UTerrainPainterWidget::QueueTextureSave(UTexture2D* Texture)
+{
+	PendingSaveTextures.AddUnique(Texture);
+	if (!SaveTicker.IsValid())
 	{
-		return { false, FString::Printf(TEXT("Failed to save package at %s."), *fileName) };
+		SaveTicker = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ThisClass::FlushTextureSaves), SaveBatchDelay);
 	}
-	
-	return { true, didCreateNew ? TEXT("Successfully created new texture!") : TEXT("Successfully overwrote texture!") };
+}
+
+bool UTerrainPainterWidget::FlushTextureSaves(float DeltaTime)
+{
+	SaveTicker.Reset();
+
+	FSavePackageArgs args;
+	args.TopLevelFlags = RF_Public | RF_Standalone;
+	// Serialized here, written to disk on a worker
+	args.SaveFlags = SAVE_Async;
+
+	TArray<FString> failed;
+	for (UTexture2D* texture : PendingSaveTextures)
+	{
+		if (!IsValid(texture)) continue;
+
+		UPackage* package{ texture->GetPackage() };
+		const FString fileName{ FPackageName::LongPackageNameToFilename(package->GetName(), FPackageName::GetAssetPackageExtension()) };
+		if (!UPackage::SavePackage(package, texture, *fileName, args))
+		{
+			failed.Add(fileName);
+		}
+	}
+	PendingSaveTextures.Reset();
+
+	if (!failed.IsEmpty())
+	{
+		ShowNotification(false, FString::Printf(TEXT("Failed to save package at %s."), *FString::Join(failed, TEXT(", "))));
+	}
+	return false;
 }
 
 void UTerrainPainterWidget::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
@@ -225,292 +443,1326 @@ void UTerrainPainterWidget::PostEditChangeProperty(FPropertyChangedEvent& Proper
 	{
 		CheckBakeEnabled();
 	}
+	else if (changed == GET_MEMBER_NAME_CHECKED(ThisClass, GraphAsset))
+	{
+		BindGraphAsset();
+		UpdatePreviewTexture();
+		if (GraphMode) UpdateGraphTexture();
+		CheckBakeEnabled();
+	}
+	else if (changed == GET_MEMBER_NAME_CHECKED(ThisClass, BakeTiers) ||
+			 changed == GET_MEMBER_NAME_CHECKED(ThisClass, BakeSplatMaps))
+	{
+		CheckBakeEnabled();
+	}
 	else if (changed == GET_MEMBER_NAME_CHECKED(ThisClass, TextureSize) ||
-			 changed == GET_MEMBER_NAME_CHECKED(ThisClass, GenerationData))
+			 changed == GET_MEMBER_NAME_CHECKED(ThisClass, FalloffKernel))
 	{
-		if (ShowPreview) UpdatePreviewTexture();
+		UpdatePreviewTexture();
 		if (GraphMode) UpdateGraphTexture();
 		CheckBakeEnabled();
 	}
+	else if (changed == GET_MEMBER_NAME_CHECKED(ThisClass, HeightmapFile) ||
+			 changed == GET_MEMBER_NAME_CHECKED(ThisClass, HeightmapResolution) ||
+			 changed == GET_MEMBER_NAME_CHECKED(ThisClass, HeightmapWorldSize))
+	{
+		ReloadHeightmap();
+		UpdatePreviewTexture();
+	}
+	else if (changed == GET_MEMBER_NAME_CHECKED(ThisClass, HeightMaskBlend) ||
+			 changed == GET_MEMBER_NAME_CHECKED(ThisClass, DebugView) ||
+			 changed == GET_MEMBER_NAME_CHECKED(ThisClass, DebugViewOpacity))
+	{
+		if (DebugView == ETerrainDebugView::None) DebugSummary.Reset();
+		UpdatePreviewTexture();
+	}
 	else if (changed == GET_MEMBER_NAME_CHECKED(ThisClass, ShowPreview))
 	{
 		PreviewImage->SetVisibility(ShowPreview ? ESlateVisibility::Visible : ESlateVisibility::Hidden);
-		if (ShowPreview) UpdatePreviewTexture(true);
+		// Hiding it drops renders still in flight, so they can't land after a later resize
+		UpdatePreviewTexture(true);
 	}
 	else if (changed == GET_MEMBER_NAME_CHECKED(ThisClass, GraphMode))
 	{
-		const ESlateVisibility vis{ GraphMode ? ESlateVisibility::Visible : ESlateVisibility::Collapsed };
-		GraphScrollBox->SetVisibility(vis);
-		GraphImage->SetVisibility(vis);
+		// The graph data view also holds the nodes, so it stays visible; only the graph parts of it are toggled
+		GraphImage->SetVisibility(GraphMode ? ESlateVisibility::Visible : ESlateVisibility::Collapsed);
+		SetupGraphDataDetailsView();
 		
 		if (GraphMode) UpdateGraphTexture();
 	}
-	else if (changed == GET_MEMBER_NAME_CHECKED(ThisClass, TerrainMapConnections))
+	else if (changed == GET_MEMBER_NAME_CHECKED(ThisClass, TerrainColorPreset))
+	{
+		GraphAsset->TerrainColorSet = TerrainColorPresets[TerrainColorPreset];
+		Algo::RandomShuffle(GraphAsset->TerrainColorSet);
+		// Not through NotifyGraphChanged, that would reset the preset again
+		GraphAsset->MarkPackageDirty();
+		ClearGallery();
+		GraphHistory.Commit(*GraphAsset, GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, TerrainColorSet), TEXT("Pick Palette Preset"));
+		UpdateHistoryButtons();
+	}
+}
+
+void UTerrainPainterWidget::BindGraphAsset()
+{
+	static const TCHAR* configSection{ TEXT("TerrainPainter") };
+	static const TCHAR* configKey{ TEXT("GraphAsset") };
+
+	if (!GraphAsset)
 	{
-		for (FTerrainGraphConnection& conn : TerrainMapConnections)
+		FString lastAssetPath;
+		if (GConfig->GetString(configSection, configKey, lastAssetPath, GEditorPerProjectIni))
 		{
-			if (conn.Element1 < 0) conn.Element1 = 0;
-			else if (conn.Element1 >= GenerationData.Num()) conn.Element1 = GenerationData.Num() - 1;
-			
-			if (conn.Element2 < 0) conn.Element2 = 0;
-			else if (conn.Element2 >= GenerationData.Num()) conn.Element2 = GenerationData.Num() - 1;
+			GraphAsset = LoadObject<UTerrainGraphAsset>(nullptr, *lastAssetPath, nullptr, LOAD_NoWarn);
 		}
-		
-		UpdateGraphTexture();
 	}
-	else if (changed == GET_MEMBER_NAME_CHECKED(ThisClass, TerrainColorSet))
+
+	if (!GraphAsset)
 	{
-		TerrainColorPreset = ETerrainColorPreset::None;
+		GraphAsset = NewObject<UTerrainGraphAsset>(GetTransientPackage(), NAME_None, RF_Transient);
 	}
-	else if (changed == GET_MEMBER_NAME_CHECKED(ThisClass, TerrainColorPreset))
+	else if (GraphAsset->IsAsset())
 	{
-		TerrainColorSet = TerrainColorPresets[TerrainColorPreset];
-		Algo::RandomShuffle(TerrainColorSet);
+		GConfig->SetString(configSection, configKey, *FSoftObjectPath(GraphAsset).ToString(), GEditorPerProjectIni);
 	}
-}
-
-
-void UTerrainPainterWidget::CheckBakeEnabled()
-{
-	BakeButton->SetIsEnabled(InputParametersValid());
-}
 
-bool UTerrainPainterWidget::InputParametersValid() const
-{
-	FString folderAbsolutePath;
-	const bool folderPathValid{ FPackageName::TryConvertLongPackageNameToFilename(TerrainColorOutputDirectory.Path, folderAbsolutePath) };
-	if (!folderPathValid) return false;
-	
-	const bool folderExists{ FPaths::DirectoryExists(folderAbsolutePath) };
-	if (!folderExists) return false;
-	
-	const FString combinedPath{ FPaths::Combine(TerrainColorOutputDirectory.Path, TerrainColorOutputAssetName) };
-	const bool combinedPathValid{ FPackageName::IsValidLongPackageName(combinedPath) };
-	if (!combinedPathValid) return false;
+	// Only ever listen to the one asset we're bound to
+	if (BoundGraphAsset.IsValid())
+	{
+		BoundGraphAsset->OnGraphChanged.RemoveAll(this);
+	}
+	GraphAsset->OnGraphChanged.AddUObject(this, &ThisClass::OnGraphAssetChanged);
 
-	const bool textureSizeValid{ TextureSize.X > 0 && TextureSize.Y > 0 && TextureSize.X < 8192 && TextureSize.Y < 8192 };
-	if (!textureSizeValid) return false;
+	// History belongs to the graph it was recorded on
+	if (BoundGraphAsset.Get() != GraphAsset)
+	{
+		GraphHistory.Reset(*GraphAsset);
+		UpdateHistoryButtons();
+		GraphIndexDirty = true;
+		SelectedNode = INDEX_NONE;
+		SelectedConnection = INDEX_NONE;
+	}
+	BoundGraphAsset = GraphAsset;
 
-	if (GenerationData.Num() == 0) return false;
-	
-	return true;
+	SetupGraphDataDetailsView();
 }
 
-void UTerrainPainterWidget::UpdatePreviewTexture(bool forceAspectRecalc)
+void UTerrainPainterWidget::SetupGraphDataDetailsView()
 {
-	if (!ShowPreview) return;
-	
-	// Make this a pointer instead of a ref (which it normally should be) because we might
-	// have to change the var's content if we need to resize
-	FTexture2DMipMap* mip{ &PreviewImageTexture->GetPlatformData()->Mips[0] };
-
-	const bool didSizeChange{ (TextureSize.X != mip->SizeX || TextureSize.Y != mip->SizeY) };
-	bool doResize{ didSizeChange };
-	if (doResize)
+	TArray<FName> properties{ GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, GenerationData) };
+	if (GraphMode)
 	{
-		doResize = true;
-		// Rebuild this mip; our texture size has changed
-		PreviewImageTexture->ReleaseResource();
-		PreviewImageTexture->GetPlatformData()->Mips.Empty();
-
-		PreviewImageTexture->GetPlatformData()->SizeX = TextureSize.X;
-		PreviewImageTexture->GetPlatformData()->SizeY = TextureSize.Y;
-		
-		mip = new FTexture2DMipMap(TextureSize.X, TextureSize.Y);
-		PreviewImageTexture->GetPlatformData()->Mips.Add(mip);
-		
-		(void)mip->BulkData.Lock(LOCK_READ_WRITE);
-		mip->BulkData.Realloc(TextureSize.X * TextureSize.Y * sizeof(FColor));
-		mip->BulkData.Unlock();
+		properties.Append({
+			GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, TerrainMapConnections),
+			GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, TerrainColorSet),
+		});
 	}
+	SetupDetailsView(GraphAsset, GraphDataDetailsView, {}, properties);
+}
 
-	USizeBox* box{ Cast<USizeBox>(ImageOverlay->GetParent()) };
-	if (box && (doResize || forceAspectRecalc))
+void UTerrainPainterWidget::OnGraphAssetChanged(FName ChangedMember, int32 ArrayIndex, EPropertyChangeType::Type ChangeType)
+{
+	if (ChangedMember == GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, TerrainColorSet))
 	{
-		const float aspect{ TextureSize.X / static_cast<float>(TextureSize.Y) };
-			box->SetMinAspectRatio(aspect);
-		box->SetMaxAspectRatio(aspect);
+		TerrainColorPreset = ETerrainColorPreset::None;
+		// Variants map onto the palette entry by entry, a different palette invalidates them
+		ClearGallery();
+		if (!IsBatchingGraphEdit && ChangeType != EPropertyChangeType::Interactive)
+		{
+			GraphHistory.Commit(*GraphAsset, ChangedMember, TEXT("Edit Palette"));
+			UpdateHistoryButtons();
+		}
+		return;
 	}
 
-	void* rawData{ mip->BulkData.Lock(LOCK_READ_WRITE) };
-	FColor* pixelData{ static_cast<FColor*>(rawData) };
-	for (int32 y{}; y < TextureSize.Y; ++y)
+	if (IsBatchingGraphEdit) return;
+
+	// Interactive changes (e.g. dragging a value) are shown right away, but only committed once let go
+	if (ChangeType == EPropertyChangeType::Interactive)
 	{
-		for (int32 x{}; x < TextureSize.X; ++x)
+		GraphIndexDirty = true;
+		if (ChangedMember == GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, GenerationData))
 		{
-			const int32 index{ y * TextureSize.X + x };
-			pixelData[index] = ComputeColorForPixel(x, y);
+			UpdatePreviewTexture();
+			CheckBakeEnabled();
 		}
+		if (GraphMode) UpdateGraphTexture();
+		return;
 	}
-	mip->BulkData.Unlock();
-	PreviewImageTexture->UpdateResource();
+
+	const FString description{ ChangedMember == GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, GenerationData) ? TEXT("Edit Nodes") : TEXT("Edit Connections") };
+	if (const FTerrainGraphTransaction* transaction{ GraphHistory.Commit(*GraphAsset, ChangedMember, description, ArrayIndex, ChangeType) })
+	{
+		RefreshForTransaction(*transaction);
+	}
+	UpdateHistoryButtons();
 }
 
-void UTerrainPainterWidget::FillTextureWithTerrainColorMap(UTexture2D* texture)
+void UTerrainPainterWidget::CommitGraphEdit(const FString& Description, FName ChangedMember)
 {
-	const int32 numPixels{ TextureSize.X * TextureSize.Y };
-	
-	TArray<FColor> pixelData;
-	pixelData.SetNumUninitialized(numPixels);
-	
-	for (int32 y{}; y < TextureSize.Y; ++y)
 	{
-		for (int32 x{}; x < TextureSize.X; ++x)
-		{
-			const int32 index{ y * TextureSize.X + x };
-			pixelData[index] = ComputeColorForPixel(x, y);
-		}
+		TGuardValue<bool> batchingEdit(IsBatchingGraphEdit, true);
+		GraphAsset->NotifyGraphChanged(ChangedMember);
 	}
 
-	// Initialize the source data (don't need to initialize platform data/mips here, they will be generated)
-	texture->Source.Init(
-		TextureSize.X, TextureSize.Y, 1, 1,
-		TSF_BGRA8, reinterpret_cast<uint8*>(pixelData.GetData())
-	);
-	texture->MipGenSettings = TMGS_NoMipmaps;
+	if (const FTerrainGraphTransaction* transaction{ GraphHistory.Commit(*GraphAsset, NAME_None, Description) })
+	{
+		RefreshForTransaction(*transaction);
+	}
+	UpdateHistoryButtons();
+}
 
-	// generate & update RHI resource
-	texture->UpdateResource();
+void UTerrainPainterWidget::RefreshForTransaction(const FTerrainGraphTransaction& Transaction)
+{
+	GraphIndexDirty = true;
+	if (!GraphAsset->GenerationData.IsValidIndex(SelectedNode)) SelectedNode = INDEX_NONE;
+	if (!GraphAsset->TerrainMapConnections.IsValidIndex(SelectedConnection)) SelectedConnection = INDEX_NONE;
+
+	if (!Transaction.Nodes.IsEmpty())
+	{
+		if (ShowPreview) UpdatePreviewIncrementally(Transaction);
+		CheckBakeEnabled();
+	}
+	if (GraphMode) UpdateGraphTexture();
 }
 
-void UTerrainPainterWidget::UpdateGraphTexture()
+void UTerrainPainterWidget::UpdatePreviewIncrementally(const FTerrainGraphTransaction& Transaction)
 {
-	if (!GraphImageRT)
+	// Normalization is per pixel, so a node can only ever affect the pixels within its support; both where it was & is now
+	FIntRect dirty;
+	for (const TTerrainGraphElementDelta<FTerrainGraphNode>& delta : Transaction.Nodes)
 	{
-		RecreateGraphTexture();
+		for (const TOptional<FTerrainGraphNode>& node : { delta.Before, delta.After })
+		{
+			if (!node.IsSet()) continue;
+			const FIntRect bounds{ FTerrainColorRasterizer::GetPixelBounds(node.GetValue(), TextureSize) };
+			if (bounds.IsEmpty()) continue;
+			dirty = dirty.IsEmpty() ? bounds : dirty.Union(bounds);
+		}
 	}
-	
-	const float texAspect{ static_cast<float>(TextureSize.X) / TextureSize.Y };
-	const float rtAspect{ GraphImageRT->GetSurfaceWidth() / GraphImageRT->GetSurfaceHeight() };
-	
-	// Tex exists, but aspect is wrong; recreate
-	if (!FMath::IsNearlyEqual(texAspect, rtAspect))
+	if (dirty.IsEmpty()) return;
+
+	if (!CanPatchPreview() || dirty.Area() > MaxIncrementalArea * TextureSize.X * TextureSize.Y)
 	{
-		RecreateGraphTexture();
+		UpdatePreviewTexture();
+		return;
 	}
 
-	GraphImageRT->UpdateResource();
+	FTerrainPreviewBufferPtr buffer{ PreviewPool->Acquire(dirty) };
+	PreparePreviewRasterizer()->RasterizeRegion(TextureSize, dirty, buffer->Pixels);
+	UploadPreviewRegion(MoveTemp(buffer));
+}
+
+bool UTerrainPainterWidget::CanPatchPreview() const
+{
+	// Debug views come with whole-image stats, so they always re-render fully
+	return PreviewImageTexture && !PendingPreview.IsValid() && !PreviewIsCheckerboard && !GraphAsset->GenerationData.IsEmpty() &&
+		DebugView == ETerrainDebugView::None && PreviewContentSize == TextureSize;
+}
 
-	if (GraphImageTexture)
+void UTerrainPainterWidget::UploadPreviewRegion(FTerrainPreviewBufferPtr Buffer)
+{
+	// A region still rendering on a worker may predate this one; render it again rather than have it land on top
+	if (PendingRegionRender.IsValid())
 	{
-		GraphImageTexture->ReleaseResource();
+		PendingRegionRender = {};
+		QueuePreviewRegion(PendingRegionRect);
 	}
 
-	// Always recreate graph texture from render target; has to be done, the only way
-	// to go RT -> Tex is ConstructTexture, which can only create not replace
-	UTexture* tex{ GraphImageRT->ConstructTexture(
-		GetTransientPackage(),
-		TEXT("GraphImageTexture"),
-		RF_Transient
-	) };
-	GraphImageTexture = Cast<UTexture2D>(tex);
+	PreviewPool->Upload(PreviewImageTexture, MoveTemp(Buffer));
 }
 
-void UTerrainPainterWidget::RecreateGraphTexture()
+void UTerrainPainterWidget::QueuePreviewRegion(const FIntRect& Region)
 {
-	if (GraphImageRT)
+	if (!Region.IsEmpty())
 	{
-		GraphImageRT->ReleaseResource();
+		QueuedPreviewRegion = QueuedPreviewRegion.IsEmpty() ? Region : QueuedPreviewRegion.Union(Region);
 	}
 
-	const float texAspect{ static_cast<float>(TextureSize.X) / TextureSize.Y };
-	// We want the graph texture on top not to reach e.g. 8192x8192, it's not needed and slows us down a lot
-	// So keep this the same aspect as the color texture, but smaller
-	GraphImageRT = UCanvasRenderTarget2D::CreateCanvasRenderTarget2D(
-		this, UCanvasRenderTarget2D::StaticClass(),
-		FMath::FloorToInt32(512 * texAspect), 512
-	);
-	GraphImageRT->ClearColor = FColor(0, 0, 0, 0);
-
-	GraphImageRT->OnCanvasRenderTargetUpdate.AddDynamic(this, &ThisClass::DrawGraphTexture);
+	if (!InteractionTicker.IsValid())
+	{
+		InteractionTicker = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ThisClass::TickInteraction));
+	}
 }
 
-void UTerrainPainterWidget::DrawGraphTexture(UCanvas* Canvas, int32 Width, int32 Height)
+bool UTerrainPainterWidget::TickInteraction(float DeltaTime)
 {
-	if (GenerationData.IsEmpty()) return;
-
-	for (const FTerrainGraphConnection& conn : TerrainMapConnections)
+	if (PendingRegionRender.IsValid() && PendingRegionRender.IsReady())
 	{
-		// Don't draw this connection if it's corrupt; our meta should prevent this from even getting here,
-		// but doesn't seem to first frame
-		if (conn.Element1 == conn.Element2 ||
-			conn.Element1 < 0 || conn.Element2 < 0 ||
-			conn.Element1 >= GenerationData.Num() ||
-			conn.Element2 >= GenerationData.Num())
+		FTerrainPreviewBufferPtr buffer{ PendingRegionRender.Consume() };
+		if (CanPatchPreview())
 		{
-			continue;
+			UploadPreviewRegion(MoveTemp(buffer));
 		}
-
-		// Draw line from 1-2 with black backdrop
-		const FVector2f uv1{ GenerationData[conn.Element1].UVCoordinates };
-		const FVector2f uv2{ GenerationData[conn.Element2].UVCoordinates };
-		const FVector2D pos1{ uv1.X * Width, uv1.Y * Height };
-		const FVector2D pos2{ uv2.X * Width, uv2.Y * Height };
-		DrawDebugCanvas2DLine(Canvas, pos1, pos2, FLinearColor::Black, 2.f);
-		DrawDebugCanvas2DLine(Canvas, pos1, pos2, FLinearColor::White, 1.f);
 	}
-	
-	for (int32 i{}; i < GenerationData.Num(); ++i)
-	{
-		const FTerrainGraphNode& data{ GenerationData[i] };
-	
-		FVector2D pos{ data.UVCoordinates.X * Width, data.UVCoordinates.Y * Height };
 
-		// Draw background circle for node
-		for (int32 j{ 1 }; j <= 10; ++j)
+	// Only one region in flight; whatever got dirty meanwhile goes out together with the next one
+	if (!PendingRegionRender.IsValid() && !QueuedPreviewRegion.IsEmpty())
+	{
+		if (!ShowPreview)
 		{
-			DrawDebugCanvas2DCircle(Canvas, pos, j, 20, FLinearColor::White);
+			QueuedPreviewRegion = {};
 		}
-		DrawDebugCanvas2DCircle(Canvas, pos, 12, 20, FLinearColor::Black);
+		else if (!CanPatchPreview())
+		{
+			QueuedPreviewRegion = {};
+			UpdatePreviewTexture();
+		}
+		else
+		{
+			PendingRegionRect = QueuedPreviewRegion;
+			QueuedPreviewRegion = {};
 
-		// Draw text of index on top of circle
-		FString text{ FString::FromInt(i) };
-		FCanvasTextItem TextItem(
-			pos - FVector2D{ 6, 12 },
-			FText::FromString(text),
-			GEditor->GetMediumFont(),
-			FLinearColor::Black
-		);
-		TextItem.Scale = FVector2D(1.5f, 1.5f);
-		TextItem.EnableShadow(FLinearColor::Gray);
-		Canvas->DrawItem(TextItem);
+			PendingRegionRender = Async(EAsyncExecution::ThreadPool,
+				[rasterizer = PreparePreviewRasterizer(), size = TextureSize, region = PendingRegionRect,
+					buffer = PreviewPool->Acquire(PendingRegionRect)]() mutable
+			{
+				rasterizer->RasterizeRegion(size, region, buffer->Pixels);
+				// Let go before the result is ready, so the next render can reuse it
+				rasterizer.Reset();
+				return MoveTemp(buffer);
+			});
+		}
 	}
-}
 
-// Remove duplicate connections, order connections by node
-void UTerrainPainterWidget::CleanupGraph()
+	const double now{ FPlatformTime::Seconds() };
+	if (GraphOverlayDirty && now - LastGraphOverlayTime >= GraphOverlayInterval)
+	{
+		GraphOverlayDirty = false;
+		LastGraphOverlayTime = now;
+		UpdateGraphTexture();
+	}
+
+	const bool isDone{ !PendingRegionRender.IsValid() && QueuedPreviewRegion.IsEmpty() && !GraphOverlayDirty };
+	if (isDone)
+	{
+		InteractionTicker.Reset();
+	}
+	return !isDone;
+}
+
+bool UTerrainPainterWidget::GetGraphUV(const FPointerEvent& MouseEvent, FVector2f& OutUV) const
+{
+	const FGeometry& geometry{ ImageOverlay->GetCachedGeometry() };
+	const FVector2D size{ geometry.GetLocalSize() };
+	if (size.X <= 0.0 || size.Y <= 0.0) return false;
+
+	OutUV = FVector2f(geometry.AbsoluteToLocal(MouseEvent.GetScreenSpacePosition()) / size);
+	return OutUV.X >= 0.f && OutUV.Y >= 0.f && OutUV.X <= 1.f && OutUV.Y <= 1.f;
+}
+
+void UTerrainPainterWidget::EnsureGraphIndex()
+{
+	if (!GraphIndexDirty) return;
+
+	GraphIndex.Build(GraphAsset->GenerationData, GraphAsset->TerrainMapConnections);
+	GraphIndexDirty = false;
+}
+
+FReply UTerrainPainterWidget::NativeOnMouseButtonDown(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent)
+{
+	const int32 variant{ GetGalleryVariantAt(InMouseEvent) };
+	if (variant != INDEX_NONE && InMouseEvent.GetEffectingButton() == EKeys::LeftMouseButton)
+	{
+		ApplyGalleryVariant(variant);
+		return FReply::Handled();
+	}
+
+	FVector2f uv;
+	if (!GraphMode || InMouseEvent.GetEffectingButton() != EKeys::LeftMouseButton || !GetGraphUV(InMouseEvent, uv))
+	{
+		return Super::NativeOnMouseButtonDown(InGeometry, InMouseEvent);
+	}
+
+	EnsureGraphIndex();
+	SelectedNode = GraphIndex.FindNode(uv, NodePickRadius);
+	SelectedConnection = SelectedNode == INDEX_NONE ? GraphIndex.FindConnection(uv, ConnectionPickRadius) : INDEX_NONE;
+
+	if (SelectedNode != INDEX_NONE)
+	{
+		GraphDrag = InMouseEvent.IsControlDown() ? ETerrainGraphDrag::Connect : ETerrainGraphDrag::MoveNode;
+		DragGrabOffset = GraphAsset->GenerationData[SelectedNode].UVCoordinates - uv;
+		DragUV = uv;
+	}
+
+	UpdateGraphTexture();
+
+	FReply reply{ FReply::Handled() };
+	if (GraphDrag != ETerrainGraphDrag::None)
+	{
+		reply.CaptureMouse(GetCachedWidget().ToSharedRef());
+	}
+	return reply;
+}
+
+FReply UTerrainPainterWidget::NativeOnMouseMove(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent)
+{
+	if (GraphDrag == ETerrainGraphDrag::None)
+	{
+		return Super::NativeOnMouseMove(InGeometry, InMouseEvent);
+	}
+
+	// The dragged node is gone (e.g. the editor's undo removed it); nothing left to drag
+	if (!GraphAsset->GenerationData.IsValidIndex(SelectedNode))
+	{
+		GraphDrag = ETerrainGraphDrag::None;
+		SelectedNode = INDEX_NONE;
+		GraphOverlayDirty = true;
+		QueuePreviewRegion({});
+		return FReply::Handled();
+	}
+
+	// Keeps tracking outside the preview while captured, clamped to its edges
+	FVector2f uv;
+	GetGraphUV(InMouseEvent, uv);
+	DragUV = FVector2f{ FMath::Clamp(uv.X, 0.f, 1.f), FMath::Clamp(uv.Y, 0.f, 1.f) };
+
+	if (GraphDrag == ETerrainGraphDrag::MoveNode)
+	{
+		FTerrainGraphNode& node{ GraphAsset->GenerationData[SelectedNode] };
+		const FVector2f newUV{ FMath::Clamp(DragUV.X + DragGrabOffset.X, 0.f, 1.f), FMath::Clamp(DragUV.Y + DragGrabOffset.Y, 0.f, 1.f) };
+		if (newUV == node.UVCoordinates) return FReply::Handled();
+
+		// Where the node was and where it is now both need re-rendering
+		const FIntRect oldBounds{ FTerrainColorRasterizer::GetPixelBounds(node, TextureSize) };
+		node.UVCoordinates = newUV;
+		QueuePreviewRegion(oldBounds);
+		QueuePreviewRegion(FTerrainColorRasterizer::GetPixelBounds(node, TextureSize));
+	}
+
+	GraphOverlayDirty = true;
+	QueuePreviewRegion({});
+	return FReply::Handled();
+}
+
+FReply UTerrainPainterWidget::NativeOnMouseButtonUp(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent)
+{
+	if (GraphDrag == ETerrainGraphDrag::None || InMouseEvent.GetEffectingButton() != EKeys::LeftMouseButton)
+	{
+		return Super::NativeOnMouseButtonUp(InGeometry, InMouseEvent);
+	}
+
+	FinishGraphDrag(true);
+	return FReply::Handled().ReleaseMouseCapture();
+}
+
+void UTerrainPainterWidget::NativeOnMouseCaptureLost(const FCaptureLostEvent& CaptureLostEvent)
+{
+	// E.g. the tab lost focus mid-drag; a moved node still has to make it into the history
+	FinishGraphDrag(false);
+	Super::NativeOnMouseCaptureLost(CaptureLostEvent);
+}
+
+void UTerrainPainterWidget::FinishGraphDrag(bool CanConnect)
+{
+	const ETerrainGraphDrag drag{ GraphDrag };
+	GraphDrag = ETerrainGraphDrag::None;
+	if (drag == ETerrainGraphDrag::None) return;
+
+	if (drag == ETerrainGraphDrag::MoveNode)
+	{
+		// The preview is already (or about to be) up to date, so only the overlay & history are left
+		TGuardValue<bool> batchingEdit(IsBatchingGraphEdit, true);
+		GraphAsset->NotifyGraphChanged(GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, GenerationData));
+		if (GraphHistory.Commit(*GraphAsset, GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, GenerationData), TEXT("Move Node"), SelectedNode, EPropertyChangeType::ValueSet))
+		{
+			GraphIndexDirty = true;
+			if (GraphDataDetailsView) GraphDataDetailsView->SetObject(GraphAsset, true);
+		}
+		UpdateHistoryButtons();
+	}
+	else if (drag == ETerrainGraphDrag::Connect && CanConnect && GraphAsset->GenerationData.IsValidIndex(SelectedNode))
+	{
+		EnsureGraphIndex();
+		const int32 target{ GraphIndex.FindNode(DragUV, NodePickRadius) };
+		FTerrainGraphConnection connection;
+		connection.Element1 = SelectedNode;
+		connection.Element2 = target;
+		if (target != INDEX_NONE && target != SelectedNode && !GraphAsset->TerrainMapConnections.Contains(connection))
+		{
+			GraphAsset->TerrainMapConnections.Add(connection);
+			SelectedConnection = GraphAsset->TerrainMapConnections.Num() - 1;
+			SelectedNode = INDEX_NONE;
+			CommitGraphEdit(TEXT("Connect Nodes"), GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, TerrainMapConnections));
+		}
+	}
+
+	GraphOverlayDirty = true;
+	QueuePreviewRegion({});
+}
+
+void UTerrainPainterWidget::UndoGraphEdit()
+{
+	// A node being dragged is committed first, so undo starts from (and reverts) where it was let go
+	FinishGraphDrag(false);
+	OnHistoryStep(GraphHistory.Undo(*GraphAsset));
+}
+
+void UTerrainPainterWidget::RedoGraphEdit()
+{
+	FinishGraphDrag(false);
+	OnHistoryStep(GraphHistory.Redo(*GraphAsset));
+}
+
+void UTerrainPainterWidget::OnHistoryStep(const FTerrainGraphTransaction* Transaction)
+{
+	// Nothing to step, or the history had to reset
+	if (!Transaction)
+	{
+		UpdateHistoryButtons();
+		return;
+	}
+
+	GraphAsset->MarkPackageDirty();
+	// The details view doesn't notice edits made behind its back
+	if (GraphDataDetailsView)
+	{
+		GraphDataDetailsView->SetObject(GraphAsset, true);
+	}
+	if (Transaction->ChangesColorSet)
+	{
+		TerrainColorPreset = ETerrainColorPreset::None;
+		// Variants map onto the palette entry by entry, a different palette invalidates them
+		ClearGallery();
+	}
+
+	RefreshForTransaction(*Transaction);
+	UpdateHistoryButtons();
+}
+
+void UTerrainPainterWidget::UpdateHistoryButtons()
+{
+	if (UndoButton)
+	{
+		UndoButton->SetIsEnabled(GraphHistory.CanUndo());
+		UndoButton->SetToolTipText(FText::FromString(FString::Printf(TEXT("Undo %s (Ctrl+Z)"), *GraphHistory.GetUndoDescription())));
+	}
+	if (RedoButton)
+	{
+		RedoButton->SetIsEnabled(GraphHistory.CanRedo());
+		RedoButton->SetToolTipText(FText::FromString(FString::Printf(TEXT("Redo %s (Ctrl+Y)"), *GraphHistory.GetRedoDescription())));
+	}
+}
+
+
+void UTerrainPainterWidget::CheckBakeEnabled()
+{
+	BakeButton->SetIsEnabled(InputParametersValid());
+}
+
+bool UTerrainPainterWidget::InputParametersValid() const
+{
+	FString folderAbsolutePath;
+	const bool folderPathValid{ FPackageName::TryConvertLongPackageNameToFilename(TerrainColorOutputDirectory.Path, folderAbsolutePath) };
+	if (!folderPathValid) return false;
+	
+	const bool folderExists{ FPaths::DirectoryExists(folderAbsolutePath) };
+	if (!folderExists) return false;
+	
+	const FString combinedPath{ FPaths::Combine(TerrainColorOutputDirectory.Path, TerrainColorOutputAssetName) };
+	const bool combinedPathValid{ FPackageName::IsValidLongPackageName(combinedPath) };
+	if (!combinedPathValid) return false;
+
+	const bool textureSizeValid{ TextureSize.X > 0 && TextureSize.Y > 0 && TextureSize.X < 8192 && TextureSize.Y < 8192 };
+	if (!textureSizeValid) return false;
+
+	for (const FTerrainBakeTier& tier : BakeTiers)
+	{
+		if (tier.Suffix.IsEmpty() || !FPackageName::IsValidLongPackageName(combinedPath + tier.Suffix)) return false;
+		if (tier.Size.X <= 0 || tier.Size.Y <= 0 || tier.Size.X >= 8192 || tier.Size.Y >= 8192) return false;
+	}
+
+	// Textures sharing a name (e.g. two tiers with the same suffix, or one ending in a splat suffix) would overwrite each other
+	TSet<FString> assetNames;
+	for (const FString& assetName : GetBakeAssetNames())
+	{
+		bool isDuplicate{};
+		assetNames.Add(assetName, &isDuplicate);
+		if (isDuplicate) return false;
+	}
+
+	if (GraphAsset->GenerationData.Num() == 0) return false;
+	
+	return true;
+}
+
+TArray<FString> UTerrainPainterWidget::GetBakeAssetNames() const
+{
+	TArray<FString> colorNames{ TerrainColorOutputAssetName };
+	for (const FTerrainBakeTier& tier : BakeTiers)
+	{
+		colorNames.Add(TerrainColorOutputAssetName + tier.Suffix);
+	}
+	if (!BakeSplatMaps) return colorNames;
+
+	TArray<FString> names;
+	for (const FString& colorName : colorNames)
+	{
+		names.Add(colorName);
+		names.Add(colorName + SplatIndicesSuffix);
+		names.Add(colorName + SplatWeightsSuffix);
+	}
+	return names;
+}
+
+void UTerrainPainterWidget::UpdatePreviewTexture(bool forceAspectRecalc)
+{
+	// Whatever the deferred first render or drag updates are still working on is outdated now, shown or not
+	PendingPreview = {};
+	PendingRegionRender = {};
+	QueuedPreviewRegion = {};
+
+	if (!ShowPreview) return;
+	PreviewIsCheckerboard = GraphAsset->GenerationData.IsEmpty();
+
+	FTerrainPreviewBufferPtr buffer{ PreviewPool->Acquire({ FIntPoint::ZeroValue, TextureSize }) };
+	if (DebugView != ETerrainDebugView::None && !PreviewIsCheckerboard)
+	{
+		RenderDebugView(buffer->Pixels);
+	}
+	else
+	{
+		RenderTerrainColorMap(buffer->Pixels);
+	}
+
+	PreparePreviewTexture(forceAspectRecalc);
+	PreviewPool->Upload(PreviewImageTexture, MoveTemp(buffer));
+}
+
+void UTerrainPainterWidget::PreparePreviewTexture(bool forceAspectRecalc)
+{
+	// Updates go through UpdateTextureRegions, so neither resizing nor uploading recreates the texture resource
+	PreviewImageTexture = PreviewPool->EnsureTexture(PreviewImageTexture, TextureSize);
+	SetPreviewBrush(PreviewImageTexture, TextureSize);
+
+	const bool doResize{ PreviewContentSize != TextureSize };
+	PreviewContentSize = TextureSize;
+	if (doResize || forceAspectRecalc)
+	{
+		UpdatePreviewAspect();
+	}
+}
+
+void UTerrainPainterWidget::SetPreviewBrush(UTexture2D* Texture, FIntPoint Size)
+{
+	const FBox2f uvRegion{ FVector2f::ZeroVector, FVector2f{ Size } / FVector2f(Texture->GetSizeX(), Texture->GetSizeY()) };
+	FSlateBrush brush{ PreviewImage->GetBrush() };
+	if (brush.GetResourceObject() == Texture && brush.GetUVRegion() == uvRegion) return;
+
+	brush.SetResourceObject(Texture);
+	brush.SetUVRegion(uvRegion);
+	brush.SetImageSize(FVector2D{ Size });
+	PreviewImage->SetBrush(brush);
+}
+
+void UTerrainPainterWidget::UpdatePreviewAspect()
+{
+	USizeBox* box{ Cast<USizeBox>(ImageOverlay->GetParent()) };
+	if (!box) return;
+
+	const float aspect{ TextureSize.X / static_cast<float>(TextureSize.Y) };
+	box->SetMinAspectRatio(aspect);
+	box->SetMaxAspectRatio(aspect);
+}
+
+void UTerrainPainterWidget::StartDeferredRender()
+{
+	FTSTicker::GetCoreTicker().RemoveTicker(DeferredRenderTicker);
+	UpdatePreviewAspect();
+
+	if (PreviewImage && ShowPreview)
+	{
+		// The thumbnail already looks like the final preview, so it's shown as is; without one, the preview fades in
+		LoadThumbnail();
+		if (PreviewThumbnailTexture)
+		{
+			SetPreviewBrush(PreviewThumbnailTexture, { PreviewThumbnailTexture->GetSizeX(), PreviewThumbnailTexture->GetSizeY() });
+			PreviewImage->SetRenderOpacity(1.f);
+		}
+		else
+		{
+			PreviewImage->SetRenderOpacity(0.f);
+		}
+
+		if (GraphAsset->GenerationData.IsEmpty() || DebugView != ETerrainDebugView::None)
+		{
+			// Just the checkerboard, nothing worth deferring; debug views are a tuning aid and rendered right away
+			UpdatePreviewTexture(true);
+		}
+		else
+		{
+			PendingPreview = Async(EAsyncExecution::ThreadPool, [rasterizer = PreparePreviewRasterizer(), size = TextureSize,
+				buffer = PreviewPool->Acquire({ FIntPoint::ZeroValue, TextureSize })]() mutable
+			{
+				rasterizer->Rasterize(size, buffer->Pixels);
+				// Let go before the result is ready, so the next render can reuse it
+				rasterizer.Reset();
+				return MoveTemp(buffer);
+			});
+		}
+	}
+
+	if (GraphImage)
+	{
+		GraphImage->SetRenderOpacity(0.f);
+		GraphRenderPending = true;
+	}
+
+	DeferredRenderTicker = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ThisClass::TickDeferredRender));
+}
+
+bool UTerrainPainterWidget::TickDeferredRender(float DeltaTime)
+{
+	if (PendingPreview.IsValid() && PendingPreview.IsReady())
+	{
+		FTerrainPreviewBufferPtr buffer{ PendingPreview.Consume() };
+
+		// Rendered for a different size; it would land outside the texture, so render again
+		if (static_cast<int32>(buffer->Region.Width) != TextureSize.X || static_cast<int32>(buffer->Region.Height) != TextureSize.Y)
+		{
+			UpdatePreviewTexture();
+		}
+		else
+		{
+			PreparePreviewTexture(false);
+			PreviewPool->Upload(PreviewImageTexture, MoveTemp(buffer));
+			PreviewIsCheckerboard = false;
+		}
+	}
+	else if (!PendingPreview.IsValid() && GraphRenderPending)
+	{
+		// A tick after the preview upload, so the two don't hitch the same frame.
+		// The overlay shows the render target itself, so redrawing it is all later updates need
+		GraphRenderPending = false;
+		UpdateGraphTexture();
+		GraphImage->SetBrushResourceObject(GraphImageRT);
+	}
+
+	const float step{ DeltaTime / FadeInDuration };
+	const auto fadeIn{ [step](UImage* image)
+	{
+		const float opacity{ FMath::Min(image->GetRenderOpacity() + step, 1.f) };
+		image->SetRenderOpacity(opacity);
+		return opacity < 1.f;
+	} };
+
+	bool isFading{ false };
+	if (PreviewImage && !PendingPreview.IsValid()) isFading |= fadeIn(PreviewImage);
+	if (GraphImage && !GraphRenderPending) isFading |= fadeIn(GraphImage);
+
+	const bool isDone{ !PendingPreview.IsValid() && !GraphRenderPending && !isFading };
+	if (isDone)
+	{
+		DeferredRenderTicker.Reset();
+	}
+	return !isDone;
+}
+
+FString UTerrainPainterWidget::GetThumbnailPath() const
+{
+	// Transient graphs don't outlive the session, so neither do their thumbnails
+	if (!GraphAsset || !GraphAsset->IsAsset()) return {};
+
+	return FPaths::Combine(
+		FPaths::ProjectSavedDir(), TEXT("TerrainPainter"),
+		FString::Printf(TEXT("%s_%08x.png"), *GraphAsset->GetName(), GetTypeHash(FSoftObjectPath(GraphAsset).ToString()))
+	);
+}
+
+void UTerrainPainterWidget::LoadThumbnail()
+{
+	PreviewThumbnailTexture = nullptr;
+
+	const FString path{ GetThumbnailPath() };
+	if (path.IsEmpty() || !FPaths::FileExists(path)) return;
+
+	FImage image;
+	if (!FImageUtils::LoadImage(*path, image)) return;
+
+	PreviewThumbnailTexture = FImageUtils::CreateTexture2DFromImage(image);
+}
+
+void UTerrainPainterWidget::SaveThumbnail() const
+{
+	const FString path{ GetThumbnailPath() };
+	if (path.IsEmpty()) return;
+
+	if (GraphAsset->GenerationData.IsEmpty())
+	{
+		IFileManager::Get().Delete(*path, false, false, true);
+		return;
+	}
+
+	// Rendered fresh at thumbnail size; cheap enough, and the preview's pixels aren't kept on the CPU
+	const FIntPoint size{ GetThumbnailResolution(ThumbnailSize) };
+
+	TArray<FColor> pixels;
+	pixels.SetNumUninitialized(size.X * size.Y);
+	MakeRasterizer().Rasterize(size, pixels);
+
+	FImageUtils::SaveImageByExtension(*path, FImageView(pixels.GetData(), size.X, size.Y));
+}
+
+FIntPoint UTerrainPainterWidget::GetThumbnailResolution(int32 LongestSide) const
+{
+	const float scale{ static_cast<float>(LongestSide) / FMath::Max(TextureSize.X, TextureSize.Y) };
+	return {
+		FMath::Max(1, FMath::RoundToInt32(TextureSize.X * scale)),
+		FMath::Max(1, FMath::RoundToInt32(TextureSize.Y * scale))
+	};
+}
+
+void UTerrainPainterWidget::ReloadHeightmap()
+{
+	Heightmap.Reset();
+	if (HeightmapFile.FilePath.IsEmpty()) return;
+
+	FString error;
+	Heightmap = FTerrainHeightmap::Open(HeightmapFile.FilePath, HeightmapResolution, HeightmapWorldSize, error);
+	if (!Heightmap)
+	{
+		ShowNotification(false, error);
+	}
+}
+
+void UTerrainPainterWidget::FillTexture(UTexture2D* texture, FIntPoint size, TArrayView64<uint8> pngData, bool isDataTexture)
+{
+	// Initialize the source data (don't need to initialize platform data/mips here, they will be generated).
+	// Kept as PNG, which makes the asset a fraction of raw BGRA8; it's decompressed when the texture is built
+	texture->Source.InitWithCompressedSourceData(size.X, size.Y, 1, TSF_BGRA8, pngData, TSCF_PNG);
+	texture->MipGenSettings = TMGS_NoMipmaps;
+
+	if (isDataTexture)
+	{
+		// Splat indices & weights must reach the material exactly as written: linear, uncompressed, unfiltered
+		texture->SRGB = false;
+		texture->CompressionSettings = TC_VectorDisplacementmap;
+		texture->Filter = TF_Nearest;
+	}
+
+	// generate & update RHI resource
+	texture->UpdateResource();
+}
+
+void UTerrainPainterWidget::UpdateGraphTexture()
+{
+	PrepareGraphTexture();
+
+	// Repaints into the existing resource; UpdateResource would recreate it on every edit
+	GraphImageRT->FastUpdateResource();
+}
+
+void UTerrainPainterWidget::PrepareGraphTexture()
+{
+	const float texAspect{ static_cast<float>(TextureSize.X) / TextureSize.Y };
+	// We want the graph texture on top not to reach e.g. 8192x8192, it's not needed and slows us down a lot
+	// So keep this the same aspect as the color texture, but smaller
+	const FIntPoint size{ FMath::FloorToInt32(512 * texAspect), 512 };
+
+	if (GraphImageRT)
+	{
+		if (GraphImageRT->SizeX != size.X || GraphImageRT->SizeY != size.Y)
+		{
+			GraphImageRT->ResizeTarget(size.X, size.Y);
+		}
+		return;
+	}
+
+	GraphImageRT = UCanvasRenderTarget2D::CreateCanvasRenderTarget2D(this, UCanvasRenderTarget2D::StaticClass(), size.X, size.Y);
+	GraphImageRT->ClearColor = FColor(0, 0, 0, 0);
+
+	GraphImageRT->OnCanvasRenderTargetUpdate.AddDynamic(this, &ThisClass::DrawGraphTexture);
+}
+
+void UTerrainPainterWidget::DrawGraphTexture(UCanvas* Canvas, int32 Width, int32 Height)
+{
+	const TArray<FTerrainGraphNode>& nodes{ GraphAsset->GenerationData };
+	if (nodes.IsEmpty()) return;
+
+	for (const FTerrainGraphConnection& conn : GraphAsset->TerrainMapConnections)
+	{
+		// Don't draw this connection if it's corrupt; our meta should prevent this from even getting here,
+		// but doesn't seem to first frame
+		if (conn.Element1 == conn.Element2 ||
+			conn.Element1 < 0 || conn.Element2 < 0 ||
+			conn.Element1 >= nodes.Num() ||
+			conn.Element2 >= nodes.Num())
+		{
+			continue;
+		}
+
+		// Draw line from 1-2 with black backdrop
+		const FVector2f uv1{ nodes[conn.Element1].UVCoordinates };
+		const FVector2f uv2{ nodes[conn.Element2].UVCoordinates };
+		const FVector2D pos1{ uv1.X * Width, uv1.Y * Height };
+		const FVector2D pos2{ uv2.X * Width, uv2.Y * Height };
+		DrawDebugCanvas2DLine(Canvas, pos1, pos2, FLinearColor::Black, 2.f);
+		DrawDebugCanvas2DLine(Canvas, pos1, pos2, FLinearColor::White, 1.f);
+	}
+	
+	for (int32 i{}; i < nodes.Num(); ++i)
+	{
+		const FTerrainGraphNode& data{ nodes[i] };
+	
+		FVector2D pos{ data.UVCoordinates.X * Width, data.UVCoordinates.Y * Height };
+
+		// Draw background circle for node
+		for (int32 j{ 1 }; j <= 10; ++j)
+		{
+			DrawDebugCanvas2DCircle(Canvas, pos, j, 20, FLinearColor::White);
+		}
+		DrawDebugCanvas2DCircle(Canvas, pos, 12, 20, FLinearColor::Black);
+
+		// Draw text of index on top of circle
+		FString text{ FString::FromInt(i) };
+		FCanvasTextItem TextItem(
+			pos - FVector2D{ 6, 12 },
+			FText::FromString(text),
+			GEditor->GetMediumFont(),
+			FLinearColor::Black
+		);
+		TextItem.Scale = FVector2D(1.5f, 1.5f);
+		TextItem.EnableShadow(FLinearColor::Gray);
+		Canvas->DrawItem(TextItem);
+	}
+
+	// Selection & the connection being dragged out on top of everything
+	const auto toCanvas{ [Width, Height](FVector2f uv){ return FVector2D{ uv.X * Width, uv.Y * Height }; } };
+	if (GraphAsset->TerrainMapConnections.IsValidIndex(SelectedConnection))
+	{
+		const FTerrainGraphConnection& conn{ GraphAsset->TerrainMapConnections[SelectedConnection] };
+		if (nodes.IsValidIndex(conn.Element1) && nodes.IsValidIndex(conn.Element2))
+		{
+			DrawDebugCanvas2DLine(Canvas, toCanvas(nodes[conn.Element1].UVCoordinates), toCanvas(nodes[conn.Element2].UVCoordinates), FLinearColor::Yellow, 3.f);
+		}
+	}
+	if (nodes.IsValidIndex(SelectedNode))
+	{
+		const FVector2D pos{ toCanvas(nodes[SelectedNode].UVCoordinates) };
+		if (GraphDrag == ETerrainGraphDrag::Connect)
+		{
+			DrawDebugCanvas2DLine(Canvas, pos, toCanvas(DragUV), FLinearColor::Yellow, 2.f);
+		}
+		DrawDebugCanvas2DCircle(Canvas, pos, 13, 20, FLinearColor::Yellow);
+		DrawDebugCanvas2DCircle(Canvas, pos, 14, 20, FLinearColor::Yellow);
+	}
+}
+
+void UTerrainPainterWidget::CleanupGraph()
+{
+	CleanupConnections();
+	CommitGraphEdit(TEXT("Cleanup Graph"), GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, TerrainMapConnections));
+}
+
+// Remove duplicate connections, order connections by node
+void UTerrainPainterWidget::CleanupConnections()
 {
 	TArray<FTerrainGraphConnection> newArray{};
-	for (FTerrainGraphConnection& conn : TerrainMapConnections)
+	for (FTerrainGraphConnection& conn : GraphAsset->TerrainMapConnections)
 	{
 		if (conn.Element1 == conn.Element2) continue;
 		if (conn.Element1 > conn.Element2) conn.Swap();
 		newArray.AddUnique(conn);
 	}
 	Algo::SortBy(newArray, [](const FTerrainGraphConnection& a){ return a.Element1; });
-	TerrainMapConnections = newArray;
+	GraphAsset->TerrainMapConnections = newArray;
 }
 
 void UTerrainPainterWidget::ApplyGraphColoring()
 {
-	CleanupGraph();
+	if (PendingColoring.IsValid()) return;
+
+	CleanupConnections();
+
+	// Tabu search uses up its whole time limit on hard graphs; it colors copies on a worker so the editor stays responsive
+	if (GraphColoringAlgorithm == EGraphColoringAlgo::TabuSearch)
+	{
+		PendingColoring = Async(EAsyncExecution::ThreadPool, [nodes = GraphAsset->GenerationData, connections = GraphAsset->TerrainMapConnections,
+			colors = GraphAsset->TerrainColorSet, timeLimit = ColoringTimeLimit]() mutable
+		{
+			GraphHelper helper(nodes, connections, colors);
+			helper.SetTimeLimit(timeLimit);
+			helper.ColorGraph(EGraphColoringAlgo::TabuSearch);
+
+			FGraphColoringResult result;
+			result.RemainingConflicts = helper.GetRemainingConflicts();
+			result.NodeColors.Reserve(nodes.Num());
+			for (const FTerrainGraphNode& node : nodes)
+			{
+				result.NodeColors.Add(node.Color);
+			}
+			return result;
+		});
+		ColoringGraphAsset = GraphAsset;
+		ColoringConnections = GraphAsset->TerrainMapConnections;
+		if (ApplyGraphColoringButton) ApplyGraphColoringButton->SetIsEnabled(false);
+		ColoringTicker = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &ThisClass::TickGraphColoring));
+		return;
+	}
 
 	// Create helper object to apply color
-	GraphHelper helper(GenerationData, TerrainMapConnections, TerrainColorSet);
+	GraphHelper helper(GraphAsset->GenerationData, GraphAsset->TerrainMapConnections, GraphAsset->TerrainColorSet);
 	helper.ColorGraph(GraphColoringAlgorithm);
 
-	UpdatePreviewTexture();
+	// Cleanup & recoloring undo as one; only the nodes whose color actually changed are recorded
+	CommitGraphEdit(TEXT("Apply Graph Coloring"), GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, GenerationData));
 }
 
-// Budget pixel shader calculations
-FColor UTerrainPainterWidget::ComputeColorForPixel(int32 X, int32 Y)
+bool UTerrainPainterWidget::TickGraphColoring(float DeltaTime)
 {
-	if (GenerationData.IsEmpty()) return ComputeCheckerboard(X, Y);	
+	if (!PendingColoring.IsReady()) return true;
+
+	const FGraphColoringResult result{ PendingColoring.Consume() };
+	ColoringTicker.Reset();
+	if (ApplyGraphColoringButton) ApplyGraphColoringButton->SetIsEnabled(true);
 
-	return ComputeWeightedTerrainColor(X, Y); 
+	// Node positions may have moved meanwhile, that doesn't matter to the coloring; other connections or nodes do
+	if (ColoringGraphAsset.Get() != GraphAsset || GraphAsset->GenerationData.Num() != result.NodeColors.Num() ||
+		GraphAsset->TerrainMapConnections != ColoringConnections)
+	{
+		ShowNotification(false, TEXT("The graph changed while it was being colored; apply the coloring again."));
+		return false;
+	}
+
+	for (int32 i{}; i < result.NodeColors.Num(); ++i)
+	{
+		GraphAsset->GenerationData[i].Color = result.NodeColors[i];
+	}
+	// Cleanup & recoloring undo as one, unless another edit committed the cleanup meanwhile
+	CommitGraphEdit(TEXT("Apply Graph Coloring"), GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, GenerationData));
+	ReportRemainingConflicts(result.RemainingConflicts);
+	return false;
 }
 
-FColor UTerrainPainterWidget::ComputeCheckerboard(int32 X, int32 Y)
+void UTerrainPainterWidget::ReportRemainingConflicts(int32 RemainingConflicts)
+{
+	if (RemainingConflicts == 0) return;
+
+	ShowNotification(false, FString::Printf(
+		TEXT("%d connections still join nodes of the same color; the palette may be too small for this graph, or try a longer time limit."),
+		RemainingConflicts));
+}
+
+void UTerrainPainterWidget::ImportGraph()
+{
+	const bool importNodes{ !NodeImportFile.FilePath.IsEmpty() };
+	const bool importConnections{ !ConnectionImportFile.FilePath.IsEmpty() };
+	if (!importNodes && !importConnections)
+	{
+		ShowNotification(false, TEXT("Set a node and/or connection file to import."));
+		return;
+	}
+
+	const double startTime{ FPlatformTime::Seconds() };
+	FString error;
+	int32 skippedLines{};
+
+	TArray<FTerrainGraphNode> nodes;
+	if (importNodes)
+	{
+		int32 skipped{};
+		if (!FTerrainGraphImporter::ImportNodes(NodeImportFile.FilePath, nodes, skipped, error))
+		{
+			ShowNotification(false, error);
+			return;
+		}
+		skippedLines += skipped;
+	}
+
+	TArray<FTerrainGraphConnection> connections;
+	if (importConnections)
+	{
+		int32 skipped{};
+		if (!FTerrainGraphImporter::ImportConnections(ConnectionImportFile.FilePath, connections, skipped, error))
+		{
+			ShowNotification(false, error);
+			return;
+		}
+		skippedLines += skipped;
+	}
+
+	// Swap everything in at once, so the whole import is a single change
+	if (importNodes) GraphAsset->GenerationData = MoveTemp(nodes);
+	if (importConnections) GraphAsset->TerrainMapConnections = MoveTemp(connections);
+
+	const int32 numNodes{ GraphAsset->GenerationData.Num() };
+	const int32 numClamped{ static_cast<int32>(Algo::CountIf(GraphAsset->TerrainMapConnections, [numNodes](const FTerrainGraphConnection& conn)
+	{
+		return conn.Element1 < 0 || conn.Element2 < 0 || conn.Element1 >= numNodes || conn.Element2 >= numNodes;
+	})) };
+	GraphAsset->ClampConnections();
+
+	CommitGraphEdit(TEXT("Import Graph"), importNodes
+		? GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, GenerationData)
+		: GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, TerrainMapConnections));
+
+	ShowNotification(true, FString::Printf(
+		TEXT("Imported %d nodes & %d connections in %.2fs (%d lines skipped, %d connections clamped)."),
+		numNodes, GraphAsset->TerrainMapConnections.Num(), FPlatformTime::Seconds() - startTime, skippedLines, numClamped
+	));
+}
+
+void UTerrainPainterWidget::ExportImage()
+{
+	if (ExportFile.FilePath.IsEmpty())
+	{
+		ShowNotification(false, TEXT("Set a file to export to."));
+		return;
+	}
+	if (GraphAsset->GenerationData.IsEmpty())
+	{
+		ShowNotification(false, TEXT("There are no nodes to export."));
+		return;
+	}
+
+	FString filePath{ ExportFile.FilePath };
+	const FString extension{ FTerrainImageWriter::GetExtension(ExportFormat) };
+	if (!FPaths::GetExtension(filePath).Equals(extension, ESearchCase::IgnoreCase))
+	{
+		filePath += TEXT(".") + extension;
+	}
+
+	const double startTime{ FPlatformTime::Seconds() };
+	FScopedSlowTask slowTask(1.f, FText::FromString(FString::Printf(TEXT("Exporting %dx%d color map..."), ExportSize.X, ExportSize.Y)));
+	slowTask.MakeDialog();
+
+	float lastProgress{};
+	FString error;
+	const bool success{ FTerrainImageExporter::Export(MakeRasterizer(), ExportSize, ExportFormat, filePath, error, [&slowTask, &lastProgress](float progress)
+	{
+		slowTask.EnterProgressFrame(progress - lastProgress);
+		lastProgress = progress;
+	}) };
+
+	if (!success)
+	{
+		ShowNotification(false, error);
+		return;
+	}
+
+	ShowNotification(true, FString::Printf(TEXT("Exported '%s' in %.2fs."), *filePath, FPlatformTime::Seconds() - startTime));
+}
+
+void UTerrainPainterWidget::RenderGallery()
+{
+	ClearGallery();
+	if (!GalleryGrid) return;
+
+	const TArray<FLinearColor>& colorSet{ GraphAsset->TerrainColorSet };
+	if (colorSet.IsEmpty() || GraphAsset->GenerationData.IsEmpty())
+	{
+		ShowNotification(false, TEXT("The gallery needs nodes and a palette to vary."));
+		return;
+	}
+
+	GalleryColorSets.Add(colorSet);
+	if (GallerySource == ETerrainGallerySource::Shuffles)
+	{
+		for (int32 i{ 1 }; i < GalleryVariants; ++i)
+		{
+			TArray<FLinearColor>& variant{ GalleryColorSets.Add_GetRef(colorSet) };
+			Algo::RandomShuffle(variant);
+		}
+	}
+	else
+	{
+		for (const TPair<ETerrainColorPreset, TArray<FLinearColor>>& preset : TerrainColorPresets)
+		{
+			TArray<FLinearColor>& variant{ GalleryColorSets.Add_GetRef(preset.Value) };
+			Algo::RandomShuffle(variant);
+		}
+	}
+
+	// One group per palette entry; nodes colored outside the palette stay out of them, no variant changes those
+	TArray<int32> nodeGroups;
+	nodeGroups.Reserve(GraphAsset->GenerationData.Num());
+	for (const FTerrainGraphNode& node : GraphAsset->GenerationData)
+	{
+		nodeGroups.Add(colorSet.IndexOfByKey(node.Color));
+	}
+
+	const FIntPoint size{ GetThumbnailResolution(GalleryThumbnailSize) };
+	FTerrainGroupWeights weights;
+	MakeRasterizer().RasterizeGroupWeights(size, nodeGroups, colorSet.Num(), weights);
+
+	TArray<FLinearColor> groupColors;
+	groupColors.SetNumUninitialized(colorSet.Num());
+
+	TArray<FColor> pixels;
+	pixels.SetNumUninitialized(size.X * size.Y);
+	for (int32 variant{}; variant < GalleryColorSets.Num(); ++variant)
+	{
+		// Palette entries map onto the variant's by index; a shorter variant wraps around
+		const TArray<FLinearColor>& variantColors{ GalleryColorSets[variant] };
+		for (int32 entry{}; entry < colorSet.Num(); ++entry)
+		{
+			groupColors[entry] = variantColors[entry % variantColors.Num()];
+		}
+		FTerrainColorRasterizer::ResolveGroupColors(weights, groupColors, pixels);
+
+		UTexture2D* texture{ FImageUtils::CreateTexture2DFromImage(FImageView(pixels.GetData(), size.X, size.Y)) };
+		GalleryTextures.Add(texture);
+
+		UImage* image{ WidgetTree->ConstructWidget<UImage>() };
+		image->SetBrushFromTexture(texture, true);
+		GalleryGrid->AddChildToUniformGrid(image, variant / GalleryColumns, variant % GalleryColumns);
+	}
+}
+
+void UTerrainPainterWidget::ClearGallery()
+{
+	if (GalleryGrid) GalleryGrid->ClearChildren();
+	GalleryTextures.Reset();
+	GalleryColorSets.Reset();
+}
+
+void UTerrainPainterWidget::ApplyGalleryVariant(int32 Variant)
+{
+	const TArray<FLinearColor> colorSet{ GraphAsset->TerrainColorSet };
+	const TArray<FLinearColor>& variantColors{ GalleryColorSets[Variant] };
+
+	for (FTerrainGraphNode& node : GraphAsset->GenerationData)
+	{
+		const int32 entry{ colorSet.IndexOfByKey(node.Color) };
+		if (entry != INDEX_NONE) node.Color = variantColors[entry % variantColors.Num()];
+	}
+
+	// Recolor & palette undo as one, so the nodes always match the palette they were colored from
+	GraphAsset->TerrainColorSet = variantColors;
+	TerrainColorPreset = ETerrainColorPreset::None;
+	CommitGraphEdit(TEXT("Apply Palette Variant"), GET_MEMBER_NAME_CHECKED(UTerrainGraphAsset, GenerationData));
+
+	// The other variants were relative to the old palette; show fresh ones around the new one
+	RenderGallery();
+}
+
+int32 UTerrainPainterWidget::GetGalleryVariantAt(const FPointerEvent& MouseEvent) const
+{
+	if (!GalleryGrid) return INDEX_NONE;
+
+	for (int32 i{}; i < GalleryGrid->GetChildrenCount(); ++i)
+	{
+		const UWidget* child{ GalleryGrid->GetChildAt(i) };
+		if (child && child->GetCachedGeometry().IsUnderLocation(MouseEvent.GetScreenSpacePosition()))
+		{
+			return GalleryColorSets.IsValidIndex(i) ? i : INDEX_NONE;
+		}
+	}
+	return INDEX_NONE;
+}
+
+void UTerrainPainterWidget::RenderTerrainColorMap(TArrayView<FColor> OutPixels)
+{
+	if (GraphAsset->GenerationData.IsEmpty())
+	{
+		for (int32 y{}; y < TextureSize.Y; ++y)
+		{
+			for (int32 x{}; x < TextureSize.X; ++x)
+			{
+				OutPixels[y * TextureSize.X + x] = ComputeCheckerboard(x, y);
+			}
+		}
+		return;
+	}
+
+	PreparePreviewRasterizer()->Rasterize(TextureSize, OutPixels);
+}
+
+void UTerrainPainterWidget::RenderDebugView(TArrayView<FColor> OutPixels)
+{
+	const int32 numPixels{ TextureSize.X * TextureSize.Y };
+	TArray<int32> nodesPerPixel;
+	TArray<int32> dominantNode;
+	TArray<float> overshoot;
+	nodesPerPixel.SetNumUninitialized(numPixels);
+	dominantNode.SetNumUninitialized(numPixels);
+	overshoot.SetNumUninitialized(numPixels);
+
+	FTerrainRasterStats stats;
+	PreparePreviewRasterizer()->RasterizeDebug(TextureSize, OutPixels, { nodesPerPixel, dominantNode, overshoot }, stats);
+
+	// Blue for little to red for a lot
+	const auto heatColor{ [](float t){ return FLinearColor::MakeFromHSV8(static_cast<uint8>((1.f - t) * 170.f), 255, 255); } };
+
+	// Pixels a view has nothing to say about keep their color
+	ParallelFor(TextureSize.Y, [this, &OutPixels, &nodesPerPixel, &dominantNode, &overshoot, &stats, &heatColor](int32 y)
+	{
+		for (int32 x{}; x < TextureSize.X; ++x)
+		{
+			const int32 index{ y * TextureSize.X + x };
+			TOptional<FLinearColor> heat;
+			switch (DebugView)
+			{
+			case ETerrainDebugView::NodesPerPixel:
+				if (nodesPerPixel[index] > 0) heat = heatColor(static_cast<float>(nodesPerPixel[index]) / stats.MaxNodesPerPixel);
+				break;
+			case ETerrainDebugView::DominantNode:
+				// Hues stepped by ~golden ratio, so neighbouring indices never look alike
+				if (dominantNode[index] != INDEX_NONE) heat = FLinearColor::MakeFromHSV8(static_cast<uint8>(dominantNode[index] * 157), 200, 255);
+				break;
+			case ETerrainDebugView::NormalizationClipping:
+				if (overshoot[index] > 0.f) heat = heatColor(FMath::Min(FMath::Log2(1.f + overshoot[index]) / MaxOvershootStops, 1.f));
+				break;
+			default:
+				break;
+			}
+
+			if (heat.IsSet())
+			{
+				// The preview holds linear values, blend them as such
+				OutPixels[index] = FMath::Lerp(OutPixels[index].ReinterpretAsLinear(), heat.GetValue(), DebugViewOpacity).ToFColor(false);
+			}
+		}
+	});
+
+	const FTerrainPreviewPool::FStats poolStats{ PreviewPool->GetStats() };
+	DebugSummary = FString::Printf(
+		TEXT("Nodes per pixel: %.2f mean, %d max. Clipped: %.1f%% of pixels. ")
+		TEXT("Preview pool: %d idle buffers (%.1f MB), %lld of %lld acquires allocated, %d textures, %d band scratch (%.1f MB idle)."),
+		stats.MeanNodesPerPixel, stats.MaxNodesPerPixel, stats.ClippedFraction * 100.0,
+		poolStats.NumFree, poolStats.FreeBytes / (1024.0 * 1024.0), poolStats.NumAllocated, poolStats.NumAcquired, poolStats.NumTextures,
+		poolStats.NumBandScratch, poolStats.BandScratchBytes / (1024.0 * 1024.0));
+
+	// The most expensive nodes are the first candidates for a smaller DistanceModifier
+	TArray<int32> nodes;
+	for (int32 i{}; i < stats.NodePixels.Num(); ++i)
+	{
+		if (stats.NodePixels[i] > 0) nodes.Add(i);
+	}
+	nodes.Sort([&stats](int32 a, int32 b){ return stats.NodePixels[a] > stats.NodePixels[b]; });
+
+	for (int32 i{}; i < FMath::Min(nodes.Num(), NumDebugSummaryNodes); ++i)
+	{
+		const int32 node{ nodes[i] };
+		DebugSummary += FString::Printf(
+			TEXT(" Node %d: %.1f%% coverage, dominant on %.1f%%."), node,
+			100.0 * stats.NodePixels[node] / numPixels, 100.0 * stats.NodeDominantPixels[node] / numPixels);
+	}
+}
+
+FTerrainColorRasterizer UTerrainPainterWidget::MakeRasterizer() const
+{
+	FTerrainColorRasterizer rasterizer(GraphAsset->GenerationData, FalloffKernel);
+	rasterizer.SetHeightmap(Heightmap, HeightMaskBlend);
+	return rasterizer;
+}
+
+TSharedPtr<FTerrainColorRasterizer, ESPMode::ThreadSafe> UTerrainPainterWidget::PreparePreviewRasterizer()
+{
+	// A render still holding on to the last one gets to keep it
+	if (!PreviewRasterizer.IsValid() || !PreviewRasterizer.IsUnique())
+	{
+		PreviewRasterizer = MakeShared<FTerrainColorRasterizer, ESPMode::ThreadSafe>(GraphAsset->GenerationData, FalloffKernel);
+		PreviewRasterizer->SetScratchPool(PreviewPool->GetBandScratch());
+	}
+	else
+	{
+		PreviewRasterizer->Prepare(GraphAsset->GenerationData, FalloffKernel);
+	}
+	PreviewRasterizer->SetHeightmap(Heightmap, HeightMaskBlend);
+	return PreviewRasterizer;
+}
+
+FColor UTerrainPainterWidget::ComputeCheckerboard(int32 X, int32 Y) const
 {
 	const int min{ FMath::Min(TextureSize.X, TextureSize.Y) };
 	const FVector2f aspectedUV{ static_cast<float>(X) / static_cast<float>(min), static_cast<float>(Y) / static_cast<float>(min) };
@@ -522,23 +1774,3 @@ FColor UTerrainPainterWidget::ComputeCheckerboard(int32 X, int32 Y)
 	const bool doColor{ mod.X == 0 || mod.Y == 0 };
 	return doColor ? FColor::Purple : FColor::Black;
 }
-
-FColor UTerrainPainterWidget::ComputeWeightedTerrainColor(int32 X, int32 Y)
-{
-	const FVector2f uv{ static_cast<float>(X) / static_cast<float>(TextureSize.X), static_cast<float>(Y) / static_cast<float>(TextureSize.Y) };
-	// In UV space, sqrt(2) is the maximum dist between 2 points
-	constexpr float MAX_UV_DIST{ 1.414213f };
-	
-	FLinearColor result{};
-	for (const FTerrainGraphNode& data : GenerationData)
-	{
-		const float dist{ FMath::Clamp(FVector2f::Distance(uv, data.UVCoordinates) * (1.f / data.DistanceModifier), 0, MAX_UV_DIST) };
-		const float normDist{ dist / MAX_UV_DIST };
-		const float invNormDist{ 1.f - normDist };
-		
-		result += data.Color * invNormDist * data.Intensity;
-	}
-	result = NormalizeToMax(result);
-	result.A = 1.f;
-	return result.ToFColor(false);
-}
@@ -0,0 +1,168 @@
+#include "TerrainPreviewPool.h"
+
+#include "TerrainColorRasterizer.h"
+#include "Misc/ScopeLock.h"
+
+void FTerrainPreviewBufferDeleter::operator()(FTerrainPreviewBuffer* Buffer) const
+{
+	if (!Buffer) return;
+
+	if (const TSharedPtr<FTerrainPreviewPool, ESPMode::ThreadSafe> pool{ Pool.Pin() })
+	{
+		pool->Recycle(Buffer);
+	}
+	else
+	{
+		delete Buffer;
+	}
+}
+
+FTerrainPreviewPool::FTerrainPreviewPool()
+	: BandScratch{ MakeShared<FTerrainBandScratchPool, ESPMode::ThreadSafe>() }
+{
+	// Recycling must not allocate either
+	Free.Reserve(MaxFreeBuffers + 1);
+}
+
+FTerrainPreviewBufferPtr FTerrainPreviewPool::Acquire(const FIntRect& Region)
+{
+	const int32 numPixels{ Region.Area() };
+
+	TUniquePtr<FTerrainPreviewBuffer> buffer;
+	{
+		FScopeLock scopeLock{ &Lock };
+		++Stats.NumAcquired;
+
+		// Smallest one that fits, so the large ones stay around for large regions
+		int32 best{ INDEX_NONE };
+		for (int32 i{}; i < Free.Num(); ++i)
+		{
+			const int32 capacity{ Free[i]->Pixels.Max() };
+			if (capacity >= numPixels && (best == INDEX_NONE || capacity < Free[best]->Pixels.Max())) best = i;
+		}
+
+		// Nothing fits; grow the largest rather than have one more around
+		if (best == INDEX_NONE)
+		{
+			for (int32 i{}; i < Free.Num(); ++i)
+			{
+				if (best == INDEX_NONE || Free[i]->Pixels.Max() > Free[best]->Pixels.Max()) best = i;
+			}
+		}
+
+		if (best != INDEX_NONE)
+		{
+			buffer = MoveTemp(Free[best]);
+			Free.RemoveAtSwap(best, EAllowShrinking::No);
+		}
+		if (!buffer || buffer->Pixels.Max() < numPixels) ++Stats.NumAllocated;
+	}
+
+	if (!buffer)
+	{
+		buffer = MakeUnique<FTerrainPreviewBuffer>();
+	}
+	if (buffer->Pixels.Max() < numPixels)
+	{
+		// Old contents are of no use, so they aren't copied over
+		buffer->Pixels.Empty(numPixels);
+	}
+	buffer->Pixels.SetNumUninitialized(numPixels, EAllowShrinking::No);
+	buffer->Region = FUpdateTextureRegion2D(Region.Min.X, Region.Min.Y, 0, 0, Region.Width(), Region.Height());
+
+	return FTerrainPreviewBufferPtr{ buffer.Release(), FTerrainPreviewBufferDeleter{ AsShared() } };
+}
+
+void FTerrainPreviewPool::Upload(UTexture2D* Texture, FTerrainPreviewBufferPtr Buffer)
+{
+	// Without a resource there's nothing to upload to; the buffer just goes back
+	if (!Texture->GetResource()) return;
+
+	// The render command owns the buffer until it's done with it
+	FTerrainPreviewBuffer* buffer{ Buffer.Release() };
+	Texture->UpdateTextureRegions(
+		0, 1, &buffer->Region, buffer->Region.Width * sizeof(FColor), sizeof(FColor), reinterpret_cast<uint8*>(buffer->Pixels.GetData()),
+		[buffer, deleter = FTerrainPreviewBufferDeleter{ AsShared() }](uint8*, const FUpdateTextureRegion2D*)
+		{
+			deleter(buffer);
+		}
+	);
+}
+
+UTexture2D* FTerrainPreviewPool::EnsureTexture(UTexture2D* Texture, FIntPoint Size)
+{
+	const auto roundUp{ [](int32 value){ return FMath::DivideAndRoundUp(value, TextureGranularity) * TextureGranularity; } };
+	const FIntPoint current{ Texture ? FIntPoint{ Texture->GetSizeX(), Texture->GetSizeY() } : FIntPoint::ZeroValue };
+	const FIntPoint fitted{ roundUp(Size.X), roundUp(Size.Y) };
+	const bool fits{ Texture && current.X >= Size.X && current.Y >= Size.Y };
+	const bool isOversized{ static_cast<int64>(current.X) * current.Y > static_cast<int64>(fitted.X) * fitted.Y * ShrinkRatio };
+
+	if (fits && !isOversized)
+	{
+		FScopeLock scopeLock{ &Lock };
+		TexturePixels = static_cast<int64>(current.X) * current.Y;
+		return Texture;
+	}
+
+	// Growing keeps covering the old size too, so going back & forth between two sizes doesn't keep reallocating;
+	// unless covering both would itself be oversized
+	const FIntPoint covering{ roundUp(FMath::Max(current.X, Size.X)), roundUp(FMath::Max(current.Y, Size.Y)) };
+	const bool isCoveringOversized{ static_cast<int64>(covering.X) * covering.Y > static_cast<int64>(fitted.X) * fitted.Y * ShrinkRatio };
+	const FIntPoint resized{ isOversized || isCoveringOversized ? fitted : covering };
+	UTexture2D* resizedTexture{ UTexture2D::CreateTransient(resized.X, resized.Y) };
+	checkf(resizedTexture, TEXT("Failed to create Preview Image Texture!"));
+
+	// Filtering along the preview's edges can sample what it doesn't cover; keep that black rather than garbage
+	FByteBulkData& bulkData{ resizedTexture->GetPlatformData()->Mips[0].BulkData };
+	FMemory::Memzero(bulkData.Lock(LOCK_READ_WRITE), bulkData.GetBulkDataSize());
+	bulkData.Unlock();
+	resizedTexture->UpdateResource();
+
+	FScopeLock scopeLock{ &Lock };
+	++Stats.NumTextures;
+	TexturePixels = static_cast<int64>(resized.X) * resized.Y;
+	TrimOversized();
+	return resizedTexture;
+}
+
+FTerrainPreviewPool::FStats FTerrainPreviewPool::GetStats() const
+{
+	FScopeLock scopeLock{ &Lock };
+	FStats stats{ Stats };
+	stats.NumFree = Free.Num();
+	for (const TUniquePtr<FTerrainPreviewBuffer>& buffer : Free)
+	{
+		stats.FreeBytes += buffer->Pixels.GetAllocatedSize();
+	}
+	stats.NumBandScratch = BandScratch->GetNumCreated();
+	stats.BandScratchBytes = BandScratch->GetFreeBytes();
+	return stats;
+}
+
+void FTerrainPreviewPool::Recycle(FTerrainPreviewBuffer* Buffer)
+{
+	FScopeLock scopeLock{ &Lock };
+	Free.Emplace(Buffer);
+	// Uploads still in flight when the texture shrank come back too large
+	TrimOversized();
+
+	if (Free.Num() > MaxFreeBuffers)
+	{
+		int32 smallest{};
+		for (int32 i{ 1 }; i < Free.Num(); ++i)
+		{
+			if (Free[i]->Pixels.Max() < Free[smallest]->Pixels.Max()) smallest = i;
+		}
+		Free.RemoveAtSwap(smallest, EAllowShrinking::No);
+	}
+}
+
+void FTerrainPreviewPool::TrimOversized()
+{
+	if (TexturePixels == 0) return;
+
+	for (int32 i{ Free.Num() - 1 }; i >= 0; --i)
+	{
+		if (Free[i]->Pixels.Max() > TexturePixels) Free.RemoveAtSwap(i, EAllowShrinking::No);
+	}
+}
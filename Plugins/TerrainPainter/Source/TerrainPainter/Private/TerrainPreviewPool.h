@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Engine/Texture2D.h"
+
+class FTerrainPreviewPool;
+class FTerrainBandScratchPool;
+
+/** Pixels of one preview upload, and the texture region they go to */
+struct FTerrainPreviewBuffer
+{
+	TArray<FColor> Pixels;
+	FUpdateTextureRegion2D Region{};
+};
+
+/** Hands buffers back to their pool rather than freeing them; frees them only once the pool is gone */
+struct FTerrainPreviewBufferDeleter
+{
+	TWeakPtr<FTerrainPreviewPool, ESPMode::ThreadSafe> Pool;
+
+	void operator()(FTerrainPreviewBuffer* Buffer) const;
+};
+
+using FTerrainPreviewBufferPtr = TUniquePtr<FTerrainPreviewBuffer, FTerrainPreviewBufferDeleter>;
+
+/**
+ * Recycles the memory preview updates go through: the pixel buffers they upload, and the band scratch their
+ * rasterizer works in. Buffers keep their capacity between uses and are handed out again for any region they fit;
+ * the preview texture grows in steps, and smaller sizes just use part of it.
+ * Nothing is kept at its high-water mark, though: the texture shrinks once sizes drop well below it, and idle buffers
+ * larger than the texture (which no upload can need anymore) are freed.
+ * What isn't pooled still allocates per render: the task & future state of async renders.
+ * Buffers may come back from any thread (uploads return them from the render thread), which is why the pool is
+ * shared: an upload still in flight keeps it alive past its widget.
+ */
+class FTerrainPreviewPool : public TSharedFromThis<FTerrainPreviewPool, ESPMode::ThreadSafe>
+{
+public:
+	struct FStats
+	{
+		// Idle buffers & the memory they hold on to
+		int32 NumFree{};
+		int64 FreeBytes{};
+		int64 NumAcquired{};
+		// Acquires that had to allocate or grow a buffer
+		int64 NumAllocated{};
+		int32 NumTextures{};
+		// Band scratch ever created (about the most bands that ran at once) & what the idle ones hold on to
+		int32 NumBandScratch{};
+		int64 BandScratchBytes{};
+	};
+
+	FTerrainPreviewPool();
+
+	/** A buffer of Region.Area() pixels, set up to upload to Region; returns to the pool once it's destroyed */
+	FTerrainPreviewBufferPtr Acquire(const FIntRect& Region);
+
+	/** Uploads Buffer into the first mip of Texture; the render thread gives it back to the pool once it's done */
+	void Upload(UTexture2D* Texture, FTerrainPreviewBufferPtr Buffer);
+
+	/**
+	 * Texture if it can hold Size without wasting most of itself, else a new transient one in steps of TextureGranularity:
+	 * grown to cover both, or shrunk to fit Size once Texture is over ShrinkRatio times larger than that.
+	 */
+	UTexture2D* EnsureTexture(UTexture2D* Texture, FIntPoint Size);
+
+	/** Scratch for the preview rasterizer's bands */
+	const TSharedRef<FTerrainBandScratchPool, ESPMode::ThreadSafe>& GetBandScratch() const { return BandScratch; }
+
+	FStats GetStats() const;
+
+	/** Idle buffers beyond this are freed, smallest first */
+	static constexpr int32 MaxFreeBuffers{ 4 };
+	static constexpr int32 TextureGranularity{ 256 };
+	static constexpr int32 ShrinkRatio{ 4 };
+
+private:
+	friend FTerrainPreviewBufferDeleter;
+	void Recycle(FTerrainPreviewBuffer* Buffer);
+	/** Frees the idle buffers larger than the texture; expects Lock to be held */
+	void TrimOversized();
+
+	mutable FCriticalSection Lock;
+	TArray<TUniquePtr<FTerrainPreviewBuffer>> Free;
+	// Pixels of the texture last handed out by EnsureTexture; no upload is larger
+	int64 TexturePixels{};
+	FStats Stats;
+	TSharedRef<FTerrainBandScratchPool, ESPMode::ThreadSafe> BandScratch;
+};
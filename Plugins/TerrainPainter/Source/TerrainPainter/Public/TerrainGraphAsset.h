@@ -0,0 +1,60 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GraphHelpers.h"
+#include "TerrainGraphAsset.generated.h"
+
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FOnTerrainGraphChanged, FName /*ChangedMember*/, int32 /*ArrayIndex*/, EPropertyChangeType::Type /*ChangeType*/);
+
+/**
+ * Persistent terrain node graph.
+ * The arrays are edited through reflection like any other property, but skip tagged serialization:
+ * they are serialized as packed, versioned blobs instead, so large graphs save & load in a single copy per array.
+ * Engine transactions leave them out: their undo is FTerrainGraphHistory's, which records per-element deltas.
+ */
+UCLASS(BlueprintType)
+class TERRAINPAINTER_API UTerrainGraphAsset : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, SkipSerialization, Category=GenerationData)
+	TArray<FTerrainGraphNode> GenerationData{};
+
+	UPROPERTY(EditAnywhere, SkipSerialization, Category=GraphData)
+	TArray<FTerrainGraphConnection> TerrainMapConnections{};
+
+	UPROPERTY(EditAnywhere, SkipSerialization, Category=GraphData)
+	TArray<FLinearColor> TerrainColorSet{};
+
+	/**
+	 * Broadcast after any of the graph's arrays were edited, with the member that changed.
+	 * Edits through the details view also pass the edited element (if known) & kind of change, programmatic ones INDEX_NONE & Unspecified.
+	 */
+	FOnTerrainGraphChanged OnGraphChanged;
+
+	/** Clamps connection indices into the range of existing nodes */
+	void ClampConnections();
+
+	/** Notifies listeners & marks the asset dirty after a programmatic edit of ChangedMember */
+	void NotifyGraphChanged(FName ChangedMember);
+
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+	virtual void GetAssetRegistryTags(FAssetRegistryTagsContext Context) const override;
+
+private:
+	/**
+	 * Nodes are saved as raw copies, so every change to FTerrainGraphNode's layout needs a new version.
+	 * The layout each version saved is frozen in TerrainGraphAsset.cpp, and LoadNodes upgrades older ones.
+	 */
+	enum class EVersion : int32
+	{
+		Initial,
+
+		VersionPlusOne,
+		Latest = VersionPlusOne - 1
+	};
+
+	void LoadNodes(FArchive& Ar, EVersion Version);
+};
@@ -3,6 +3,9 @@
 #pragma once
 
 #include "Modules/ModuleManager.h"
+#include "UObject/StrongObjectPtr.h"
+
+class UEditorUtilityWidgetBlueprint;
 
 class FTerrainPainterModule final : public IModuleInterface
 {
@@ -16,4 +19,10 @@ private:
 	void RegisterMenus();
 
 	void OpenTerrainPainterWidget();
+
+	/** Starts loading the widget blueprint in the background, so opening the tab doesn't have to */
+	void PreloadWidgetBlueprint();
+
+	TStrongObjectPtr<UEditorUtilityWidgetBlueprint> WidgetBlueprint;
+	FDelegateHandle PostEngineInitHandle;
 };
@@ -4,17 +4,27 @@
 
 #include "EditorUtilityWidgetComponents.h"
 #include "CoreMinimal.h"
+#include "Containers/Ticker.h"
 #include "Editor/Blutility/Classes/EditorUtilityWidget.h"
 #include "Components/Image.h"
 #include "Components/Overlay.h"
 #include "Components/SinglePropertyView.h"
 #include "Engine/CanvasRenderTarget2D.h"
+#include "FalloffKernels.h"
 #include "GraphHelpers.h"
+#include "TerrainGraphAsset.h"
+#include "TerrainGraphHistory.h"
+#include "TerrainGraphSpatialIndex.h"
+#include "TerrainImageExporter.h"
+#include "TerrainPreviewPool.h"
 #include "TerrainPainterWidget.generated.h"
 
 class UCanvasRenderTarget2D;
 class UButton;
 class UDetailsView;
+class UUniformGridPanel;
+class FTerrainColorRasterizer;
+class FTerrainHeightmap;
 
 
 UENUM(BlueprintType)
@@ -29,6 +39,65 @@ enum class ETerrainColorPreset : uint8
 };
 
 
+// How the extra bake tiers get their pixels
+UENUM(BlueprintType)
+enum class ETerrainTierSource : uint8
+{
+	// Rasterized with the falloff kernel at their own size
+	Kernel,
+	// Box-filtered from the largest output where its size is an even multiple, otherwise rasterized
+	Downsample,
+};
+
+
+// An extra resolution baked alongside TextureSize, saved as <Name><Suffix>
+USTRUCT(BlueprintType)
+struct FTerrainBakeTier
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere)
+	FString Suffix{ "_Low" };
+
+	UPROPERTY(EditAnywhere, meta=(UIMin=32, UIMax=4096, ClampMin=32, ClampMax=4096, FixedIncrement=32))
+	FIntPoint Size{ 256, 256 };
+};
+
+
+// Heatmaps drawn over the preview to see where rasterization spends its time or saturates
+UENUM(BlueprintType)
+enum class ETerrainDebugView : uint8
+{
+	None,
+	// How many nodes get evaluated per pixel, relative to the maximum
+	NodesPerPixel,
+	// The node contributing the most to each pixel, one color per node
+	DominantNode,
+	// How far NormalizeToMax had to scale the accumulated color down
+	NormalizationClipping,
+};
+
+
+// Where the gallery's palette variants come from
+UENUM(BlueprintType)
+enum class ETerrainGallerySource : uint8
+{
+	// Random permutations of the graph's palette
+	Shuffles,
+	// Every preset, each shuffled like picking it would
+	Presets,
+};
+
+
+enum class ETerrainGraphDrag : uint8
+{
+	None,
+	MoveNode,
+	// Dragging a new connection out of a node, started with Ctrl held
+	Connect
+};
+
+
 UCLASS()
 class TERRAINPAINTER_API UTerrainPainterWidget : public UEditorUtilityWidget
 {
@@ -68,9 +137,34 @@ public:
 	UPROPERTY(meta=(BindWidget))
 	UButton* ApplyGraphColoringButton; 
 
+	UPROPERTY(meta=(BindWidgetOptional))
+	UButton* ImportGraphButton{};
+
+	UPROPERTY(meta=(BindWidgetOptional))
+	UButton* ExportButton{};
+
+	UPROPERTY(meta=(BindWidgetOptional))
+	UButton* UndoButton{};
+
+	UPROPERTY(meta=(BindWidgetOptional))
+	UButton* RedoButton{};
+
+	UPROPERTY(meta=(BindWidgetOptional))
+	UButton* GalleryButton{};
+
+	// Holds the gallery thumbnails; clicking one applies its palette
+	UPROPERTY(meta=(BindWidgetOptional))
+	UUniformGridPanel* GalleryGrid{};
+
 
 	virtual void NativePreConstruct() override;
 	virtual void NativeConstruct() override;
+	virtual void NativeDestruct() override;
+	virtual FReply NativeOnKeyDown(const FGeometry& InGeometry, const FKeyEvent& InKeyEvent) override;
+	virtual FReply NativeOnMouseButtonDown(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent) override;
+	virtual FReply NativeOnMouseMove(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent) override;
+	virtual FReply NativeOnMouseButtonUp(const FGeometry& InGeometry, const FPointerEvent& InMouseEvent) override;
+	virtual void NativeOnMouseCaptureLost(const FCaptureLostEvent& CaptureLostEvent) override;
 	
 protected:
 	// Property View Props
@@ -83,9 +177,75 @@ protected:
 	
 	UPROPERTY(EditDefaultsOnly, Category=TextureDetails, meta=(UIMin=32, UIMax=4096, ClampMin=32, ClampMax=4096, FixedIncrement=32))
 	FIntPoint TextureSize{ 512, 512 };
+
+	// Additionally bakes <Name>_SplatIndices & <Name>_SplatWeights, holding the 4 strongest texture layers per pixel
+	UPROPERTY(EditDefaultsOnly, Category=TextureDetails)
+	bool BakeSplatMaps{ false };
+
+	// Extra resolutions baked in the same pass as TextureSize, e.g. LODs or minimap versions
+	UPROPERTY(EditDefaultsOnly, Category=TextureDetails)
+	TArray<FTerrainBakeTier> BakeTiers;
+
+	// Splat maps can't be filtered, so tiers with splat maps are always rasterized
+	UPROPERTY(EditDefaultsOnly, Category=TextureDetails)
+	ETerrainTierSource TierSource{ ETerrainTierSource::Downsample };
 	
+	// Graph the tool edits; the last one used is remembered per project. Without one, edits go to a transient graph
 	UPROPERTY(EditDefaultsOnly, Category=GenerationData)
-	TArray<FTerrainGraphNode> GenerationData{};
+	UTerrainGraphAsset* GraphAsset{};
+
+	UPROPERTY(EditDefaultsOnly, Category=GenerationData)
+	ETerrainFalloff FalloffKernel{ ETerrainFalloff::Linear };
+
+	// Optional 16-bit heightmap (RAW/R16 or PNG) for the nodes' height & slope ranges; streamed in tiles, never fully loaded
+	UPROPERTY(EditDefaultsOnly, Category=Heightmap, meta=(FilePathFilter="Heightmap (*.r16;*.raw;*.png)|*.r16;*.raw;*.png"))
+	FFilePath HeightmapFile{};
+
+	// Only needed for RAW files that aren't square
+	UPROPERTY(EditDefaultsOnly, Category=Heightmap, meta=(ClampMin=0))
+	FIntPoint HeightmapResolution{ 0, 0 };
+
+	// Terrain extents in world units, Z being the full height range of the heightmap; used to derive slopes
+	UPROPERTY(EditDefaultsOnly, Category=Heightmap)
+	FVector HeightmapWorldSize{ 100800.0, 100800.0, 25600.0 };
+
+	UPROPERTY(EditDefaultsOnly, Category=Heightmap, meta=(UIMin=0, UIMax=0.25f, ClampMin=0))
+	float HeightMaskBlend{ 0.05f };
+
+	// CSV of u, v, r, g, b, intensity, distance modifier[, texture layer] per line; replaces all nodes on import
+	UPROPERTY(EditDefaultsOnly, Category=Import, meta=(FilePathFilter="CSV (*.csv;*.txt)|*.csv;*.txt"))
+	FFilePath NodeImportFile{};
+
+	// CSV of node index pairs per line; replaces all connections on import
+	UPROPERTY(EditDefaultsOnly, Category=Import, meta=(FilePathFilter="CSV (*.csv;*.txt)|*.csv;*.txt"))
+	FFilePath ConnectionImportFile{};
+
+	// Streams the color map straight to an image file; unlike baking, sizes beyond texture limits are fine
+	UPROPERTY(EditDefaultsOnly, Category=Export, meta=(FilePathFilter="Image (*.png;*.exr;*.raw)|*.png;*.exr;*.raw"))
+	FFilePath ExportFile{};
+
+	UPROPERTY(EditDefaultsOnly, Category=Export)
+	ETerrainExportFormat ExportFormat{ ETerrainExportFormat::PNG };
+
+	UPROPERTY(EditDefaultsOnly, Category=Export, meta=(UIMin=32, UIMax=16384, ClampMin=32, ClampMax=65536))
+	FIntPoint ExportSize{ 4096, 4096 };
+
+	UPROPERTY(EditDefaultsOnly, Category=Debug)
+	ETerrainDebugView DebugView{ ETerrainDebugView::None };
+
+	UPROPERTY(EditDefaultsOnly, Category=Debug, meta=(ClampMin=0, ClampMax=1))
+	float DebugViewOpacity{ 0.75f };
+
+	// Cost & saturation stats of the last debug view render, with the most expensive nodes to tune first, and preview pool usage
+	UPROPERTY(VisibleAnywhere, Category=Debug)
+	FString DebugSummary;
+
+	UPROPERTY(EditDefaultsOnly, Category=Gallery)
+	ETerrainGallerySource GallerySource{ ETerrainGallerySource::Shuffles };
+
+	// Number of shuffles shown, the current palette included
+	UPROPERTY(EditDefaultsOnly, Category=Gallery, meta=(ClampMin=1, ClampMax=64))
+	int32 GalleryVariants{ 12 };
 
 	UPROPERTY(EditDefaultsOnly) bool ShowPreview{ true };
 
@@ -93,47 +253,213 @@ protected:
 	UPROPERTY(EditDefaultsOnly)
 	bool GraphMode{ true };
 	
-	UPROPERTY(EditDefaultsOnly, Category=GraphData)
-	TArray<FTerrainGraphConnection> TerrainMapConnections{};
-
-	UPROPERTY(EditDefaultsOnly, Category=GraphData)
-	TArray<FLinearColor> TerrainColorSet{};
-
 	UPROPERTY(EditDefaultsOnly, Category=GraphData)
 	ETerrainColorPreset TerrainColorPreset{};
 
 	UPROPERTY(EditDefaultsOnly, Category=GraphData)
 	EGraphColoringAlgo GraphColoringAlgorithm{};
+
+	// Seconds TabuSearch may spend looking for a coloring without conflicts
+	UPROPERTY(EditDefaultsOnly, Category=GraphData, meta=(ClampMin=0.01, UIMax=10))
+	float ColoringTimeLimit{ 1.f };
 	
 	// Props
+	// Grown as needed, never shrunk; the preview shows its PreviewContentSize top left corner
 	UPROPERTY() UTexture2D* PreviewImageTexture{};
+	// Shown as is by the graph overlay, and resized in place when the aspect changes
 	UPROPERTY() UCanvasRenderTarget2D* GraphImageRT{};
-	UPROPERTY() UTexture2D* GraphImageTexture{};
+	UPROPERTY() UTexture2D* PreviewThumbnailTexture{};
+	UPROPERTY() TArray<UTexture2D*> GalleryTextures;
+
+	// Palette of each gallery thumbnail, the graph's current one first
+	TArray<TArray<FLinearColor>> GalleryColorSets;
+
+	/** Longest side of the gallery thumbnails */
+	static constexpr int32 GalleryThumbnailSize{ 128 };
+	static constexpr int32 GalleryColumns{ 4 };
+
+	TSharedPtr<FTerrainHeightmap> Heightmap;
+	TWeakObjectPtr<UTerrainGraphAsset> BoundGraphAsset;
+
+	FTerrainGraphHistory GraphHistory;
+	// Set while the widget edits the graph itself; it commits those edits as one transaction afterwards
+	bool IsBatchingGraphEdit{};
+	// Whether the preview currently shows the checkerboard, which incremental updates can't patch
+	bool PreviewIsCheckerboard{};
+	FIntPoint PreviewContentSize{};
+
+	// Pixel buffers & texture of preview updates, reused across edits & resizes
+	TSharedRef<FTerrainPreviewPool, ESPMode::ThreadSafe> PreviewPool{ MakeShared<FTerrainPreviewPool, ESPMode::ThreadSafe>() };
+	TSharedPtr<FTerrainColorRasterizer, ESPMode::ThreadSafe> PreviewRasterizer;
+
+	/** Clipping heat saturates at this many doublings beyond full intensity */
+	static constexpr float MaxOvershootStops{ 3.f };
+	/** Nodes listed in DebugSummary, by evaluated pixels */
+	static constexpr int32 NumDebugSummaryNodes{ 3 };
+
+	/** Incremental preview updates covering more than this share of the image just re-render all of it */
+	static constexpr float MaxIncrementalArea{ 0.5f };
+
+	// Direct manipulation on the graph overlay
+	FTerrainGraphSpatialIndex GraphIndex;
+	bool GraphIndexDirty{ true };
+	int32 SelectedNode{ INDEX_NONE };
+	int32 SelectedConnection{ INDEX_NONE };
+	ETerrainGraphDrag GraphDrag{ ETerrainGraphDrag::None };
+	FVector2f DragGrabOffset{};
+	FVector2f DragUV{};
+
+	// Drag updates are coalesced per tick: dirty preview pixels pile up here while one region renders on a worker
+	FIntRect QueuedPreviewRegion;
+	FIntRect PendingRegionRect;
+	TFuture<FTerrainPreviewBufferPtr> PendingRegionRender;
+	bool GraphOverlayDirty{};
+	double LastGraphOverlayTime{};
+	FTSTicker::FDelegateHandle InteractionTicker;
+
+	/** Pick distances in UV, matching the drawn node circles & lines on the 512 high overlay */
+	static constexpr float NodePickRadius{ 12.f / 512.f };
+	static constexpr float ConnectionPickRadius{ 4.f / 512.f };
+	/** Redrawing the overlay is a canvas pass on the render thread, so while dragging it's done at most this often */
+	static constexpr double GraphOverlayInterval{ 1.0 / 20.0 };
+
+	// Deferred first render; the preview is rasterized on a worker, the graph overlay drawn a tick later
+	TFuture<FTerrainPreviewBufferPtr> PendingPreview;
+	bool GraphRenderPending{};
+	FTSTicker::FDelegateHandle DeferredRenderTicker;
+
+	// Tabu search coloring on a worker: the node colors it settled on & the connections still in conflict
+	struct FGraphColoringResult
+	{
+		TArray<FLinearColor> NodeColors;
+		int32 RemainingConflicts{};
+	};
+	TFuture<FGraphColoringResult> PendingColoring;
+	// What the pending coloring was started on; any other graph by the time it's done discards it
+	TWeakObjectPtr<UTerrainGraphAsset> ColoringGraphAsset;
+	TArray<FTerrainGraphConnection> ColoringConnections;
+	FTSTicker::FDelegateHandle ColoringTicker;
+
+	/** Longest side of the thumbnail that stands in for the preview while it's rendered */
+	static constexpr int32 ThumbnailSize{ 256 };
+	static constexpr float FadeInDuration{ 0.25f };
+
+	// Baked textures waiting to be saved; bakes in quick succession are saved together, each package once
+	UPROPERTY() TArray<UTexture2D*> PendingSaveTextures;
+	FTSTicker::FDelegateHandle SaveTicker;
+
+	/** Seconds a bake waits for others to save along with it */
+	static constexpr float SaveBatchDelay{ 0.5f };
+
+	/** Appended to a baked color texture's name for its splat maps */
+	static constexpr const TCHAR* SplatIndicesSuffix{ TEXT("_SplatIndices") };
+	static constexpr const TCHAR* SplatWeightsSuffix{ TEXT("_SplatWeights") };
 
 	// Methods
 	UFUNCTION() void OnBakeClicked();
+	static void ShowNotification(bool Success, const FString& Message);
 	void CheckBakeEnabled();
 	bool InputParametersValid() const;
+	/** Names of all textures a bake writes: the color map & its tiers, each with its splat maps if baked */
+	TArray<FString> GetBakeAssetNames() const;
 	TTuple<bool, FString> TryBakeTexture();
+	/** Creates or updates the texture asset from PNG compressed source and queues its package for saving */
+	TTuple<bool, FString> TryWriteTextureAsset(const FString& AssetName, FIntPoint Size, TArrayView64<uint8> PngData, bool IsDataTexture, bool& OutCreatedNew);
+	void QueueTextureSave(UTexture2D* Texture);
+	/** Saves all queued packages in one go, writing the files asynchronously */
+	bool FlushTextureSaves(float DeltaTime = 0.f);
 	
 	void UpdatePreviewTexture(bool forceAspectRecalc = false);
+	/** Makes sure the preview texture can hold TextureSize and is shown at that size, ready for a full upload */
+	void PreparePreviewTexture(bool forceAspectRecalc);
+	/** Shows the Size top left corner of Texture in the preview */
+	void SetPreviewBrush(UTexture2D* Texture, FIntPoint Size);
+	void UpdatePreviewAspect();
+
+	/** Shows the cached thumbnail right away and schedules the real preview & graph overlay to fade in once ready */
+	void StartDeferredRender();
+	bool TickDeferredRender(float DeltaTime);
+	FString GetThumbnailPath() const;
+	void LoadThumbnail();
+	void SaveThumbnail() const;
+	void ReloadHeightmap();
 	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
 
+	/** Binds GraphAsset (falling back to the last used or a transient one) to the details view & change notifications */
+	void BindGraphAsset();
+	void SetupGraphDataDetailsView();
+	void OnGraphAssetChanged(FName ChangedMember, int32 ArrayIndex, EPropertyChangeType::Type ChangeType);
+
+	/** Commits an edit the widget made to the graph as a single, named transaction */
+	void CommitGraphEdit(const FString& Description, FName ChangedMember);
+	/** Brings preview, graph overlay & bake state up to date with a committed, undone or redone transaction */
+	void RefreshForTransaction(const FTerrainGraphTransaction& Transaction);
+	/** Re-renders only the preview pixels the transaction's nodes can reach */
+	void UpdatePreviewIncrementally(const FTerrainGraphTransaction& Transaction);
+	UFUNCTION() void UndoGraphEdit();
+	UFUNCTION() void RedoGraphEdit();
+	void OnHistoryStep(const FTerrainGraphTransaction* Transaction);
+	void UpdateHistoryButtons();
+
+	/** UV on the preview under the mouse; false if it's outside the preview */
+	bool GetGraphUV(const FPointerEvent& MouseEvent, FVector2f& OutUV) const;
+	void EnsureGraphIndex();
+	/** Whether the current preview can be patched region by region, rather than rendered anew */
+	bool CanPatchPreview() const;
+	void UploadPreviewRegion(FTerrainPreviewBufferPtr Buffer);
+	/** Marks preview pixels (and the overlay) for re-rendering on a worker, once per tick at most */
+	void QueuePreviewRegion(const FIntRect& Region);
+	bool TickInteraction(float DeltaTime);
+	/** Ends the current drag, committing a moved node or (if CanConnect) the dragged out connection */
+	void FinishGraphDrag(bool CanConnect);
+
 	void UpdateGraphTexture();
-	void RecreateGraphTexture();
+	/** Creates the overlay render target, or resizes it to match the preview's aspect */
+	void PrepareGraphTexture();
 	UFUNCTION() void DrawGraphTexture(UCanvas* Canvas, int32 Width, int32 Height);
 	UFUNCTION() void CleanupGraph();
+	void CleanupConnections();
 	UFUNCTION() void ApplyGraphColoring();
-	
+	/** Applies the pending tabu search coloring once it's done, unless the graph's connections changed meanwhile */
+	bool TickGraphColoring(float DeltaTime);
+	static void ReportRemainingConflicts(int32 RemainingConflicts);
+	UFUNCTION() void ImportGraph();
+	UFUNCTION() void ExportImage();
+
 	/**
-	 * Creates a texture and paints the terrain color on it. This must be both repackaged and object flags must be set.
-	 * @return The texture with no flags in transient outer
+	 * Renders a thumbnail per palette variant into GalleryGrid.
+	 * Per-pixel weights of the palette entries are rasterized once; every variant is only a weighted sum of its colors.
 	 */
-	void FillTextureWithTerrainColorMap(UTexture2D* texture);
+	UFUNCTION() void RenderGallery();
+	void ClearGallery();
+	/** Recolors the nodes with the variant's palette, entry by entry, and makes it the graph's palette */
+	void ApplyGalleryVariant(int32 Variant);
+	/** Gallery thumbnail under the mouse, or INDEX_NONE */
+	int32 GetGalleryVariantAt(const FPointerEvent& MouseEvent) const;
+	/** TextureSize scaled down to LongestSide, keeping the aspect */
+	FIntPoint GetThumbnailResolution(int32 LongestSide) const;
 	
-	FColor ComputeColorForPixel(int32 X, int32 Y);
-	FColor ComputeCheckerboard(int32 X, int32 Y);
-	FColor ComputeWeightedTerrainColor(int32 X, int32 Y);
+	/**
+	 * Initializes the texture's source data from a size sized PNG, which the asset keeps compressed.
+	 * Data textures (e.g. splat maps) are set up to be sampled linearly, uncompressed and unfiltered.
+	 */
+	void FillTexture(UTexture2D* texture, FIntPoint size, TArrayView64<uint8> pngData, bool isDataTexture);
+
+	/** Rasterizer set up with the current nodes, falloff & heightmap */
+	FTerrainColorRasterizer MakeRasterizer() const;
+
+	/**
+	 * Like MakeRasterizer, but for preview renders: updates PreviewRasterizer in place and has it work in the pool's
+	 * band scratch. Async renders must let go of it before their result is ready, or the next one can't reuse it.
+	 */
+	TSharedPtr<FTerrainColorRasterizer, ESPMode::ThreadSafe> PreparePreviewRasterizer();
+
+	/** Renders the current terrain color map (or a checkerboard if there are no nodes) at TextureSize */
+	void RenderTerrainColorMap(TArrayView<FColor> OutPixels);
+
+	/** Renders the color map at TextureSize with the DebugView heatmap over it, and updates DebugSummary */
+	void RenderDebugView(TArrayView<FColor> OutPixels);
+	FColor ComputeCheckerboard(int32 X, int32 Y) const;
 
 	static const TMap<ETerrainColorPreset, TArray<FLinearColor>> TerrainColorPresets;
 };
@@ -36,8 +36,12 @@ public class TerrainPainter : ModuleRules
 			"CoreUObject",
 			"Engine",
 			"Slate",
-			"SlateCore"
+			"SlateCore",
+			"ImageWrapper",
+			"ImageCore"
 		});
+
+		AddEngineThirdPartyPrivateStaticDependencies(Target, "zlib");
 		
 		if (Target.bBuildEditor)
 		{